@@ -0,0 +1,808 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "stb_image.h"
+#include "stb_image_resize.h"
+
+#include "asset_pack.h"
+#include "mesh.h"
+#include "mesh_registry.h"
+#include "profiler.h"
+#include "texture_cache.h"
+#include "texture_file.h"
+#include "thread_pool.h"
+#include "upload_ring.h"
+
+// Loads meshes and images in the background so the first frame does not wait for them.
+// Parsing and decoding run on the thread pool; the results are queued and update() uploads them on the main thread,
+// which owns the GL context, a few per frame. Until then every asset is a placeholder: meshes draw nothing,
+// textures are a single grey texel. The handles handed out never change, the real data replaces the placeholder; since
+// a texture with immutable storage cannot be resized, its GL name does, so bind textures through their handle.
+// Texels reach the GL through an UploadRing, written by the loader threads and copied on the GPU. An upload the ring
+// cannot hold is copied from client memory a few rows per frame instead, within the same byte budget as the streaming.
+// Baked textures arrive as their smallest mips first, usable right away; the finer levels are staged by the loader
+// threads one at a time and copied in stripes, no more than a fixed number of bytes per frame, each level lowering
+// GL_TEXTURE_BASE_LEVEL once it is complete
+class AssetLoader
+{
+public:
+	explicit AssetLoader(ThreadPool& pool = ThreadPool::shared()) : pool(pool) {}
+
+	~AssetLoader() {
+		// the jobs report back to this object, and none may wait for ring space that is never freed
+		ring.close();
+		for (std::future<void>& job : jobs) {
+			job.wait();
+		}
+		if (glfwGetCurrentContext() != nullptr) {
+			if (pixelBuffer != 0) {
+				glDeleteBuffers(1, &pixelBuffer);
+			}
+			for (const Piecewise& piece : committing) {
+				if (piece.id != 0) {
+					glDeleteTextures(1, &piece.id);
+				}
+			}
+			ring.destroy();
+		}
+	}
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	// Mesh from the registry, loaded in the background if it is new. The upload uses the attribute locations of shader,
+	// like Mesh::makeObject. A mesh requested a second time is shared and only loaded once. With materialTextures the
+	// diffuse maps of its materials are loaded from that cache once the mesh arrived, for Mesh::drawMaterials
+	std::shared_ptr<Mesh> loadMesh(MeshRegistry& registry, const std::string& path, Shader shader, bool texture = true, VertexFormat vertexFormat = VertexFormat::Float32,
+		TextureCache* materialTextures = nullptr) {
+		bool created = false;
+		std::shared_ptr<Mesh> mesh = registry.acquireDeferred(path, created);
+		if (!created) {
+			return mesh;
+		}
+		requested++;
+		jobs.push_back(pool.submit([this, mesh, path, shader, texture, vertexFormat, materialTextures]() {
+			try {
+				mesh->load(path.c_str());
+			}
+			catch (const std::exception& e) {
+				std::cout << "ERROR::ASSET_LOADER::MESH_NOT_LOADED: " << path << " (" << e.what() << ")" << std::endl;
+			}
+			enqueue([this, mesh, shader, texture, vertexFormat, materialTextures]() {
+				mesh->makeObject(shader, texture, vertexFormat);
+				if (materialTextures != nullptr) {
+					mesh->materialTextures.assign(mesh->materials.size(), nullptr);
+					for (size_t i = 1; i < mesh->materials.size(); i++) {
+						if (!mesh->materials[i].diffuseMap.empty()) {
+							mesh->materialTextures[i] = loadTexture(*materialTextures, mesh->materials[i].diffuseMap);
+						}
+					}
+				}
+			});
+		}));
+		return mesh;
+	}
+
+	// 2D texture from the cache, loaded in the background if it is new, with the same sampling as before and
+	// mipmapped once the image arrived. A baked .vrtex of the image is uploaded instead, compressed and with its
+	// own mips. The same path and format requested again share one texture
+	std::shared_ptr<Texture> loadTexture(TextureCache& cache, const std::string& path, GLenum internalFormat = GL_RGB) {
+		bool created = false;
+		std::shared_ptr<Texture> texture = cache.acquireDeferred(path, internalFormat, created);
+		if (!created) {
+			return texture;
+		}
+		createPlaceholder(*texture, { GL_TEXTURE_2D });
+		startStreaming();
+
+		requested++;
+		jobs.push_back(pool.submit([this, texture, path]() {
+			std::shared_ptr<TextureUpload> upload = std::make_shared<TextureUpload>();
+			std::shared_ptr<TextureStream> stream;
+			const TextureFileHeader* header = nullptr;
+			std::shared_ptr<AssetFile> baked = loadBaked(path, true, header);
+			if (baked) {
+				GLint first = tailLevel(*header);
+				addBaked(*upload, GL_TEXTURE_2D, baked, *header, first);
+				if (first > 0) {
+					stream = makeStream(texture, { baked }, { header }, { GL_TEXTURE_2D }, first);
+				}
+			}
+			else {
+				std::shared_ptr<Image> image = decode(path, true);
+				if (!image->pixels) {
+					enqueue([]() {});
+					return;
+				}
+				addImage(*upload, GL_TEXTURE_2D, image, texture->internalFormat);
+				upload->levelCount = mipLevels(image->width, image->height);
+				upload->generateMipmap = true;
+			}
+			stage(*upload);
+			deliver(texture, upload, stream, true);
+		}));
+		return texture;
+	}
+
+	// Cube map from one image per face. The faces are decoded in parallel and uploaded together,
+	// a cube map with faces of different sizes would be incomplete. Baked faces are only used if all six are.
+	// A background load does not count towards progress() and done(), e.g. a prefetch while the scene is running
+	std::shared_ptr<Texture> loadCubemap(const std::vector<std::pair<std::string, GLenum>>& faces, bool background = false) {
+		std::shared_ptr<Texture> texture = std::make_shared<Texture>(GL_TEXTURE_CUBE_MAP, GL_RGB, faces.empty() ? std::string() : faces[0].first);
+		std::vector<GLenum> targets;
+		for (const std::pair<std::string, GLenum>& face : faces) {
+			targets.push_back(face.second);
+		}
+		createPlaceholder(*texture, targets);
+		startStreaming();
+
+		requested += background ? 0 : 1;
+		jobs.push_back(pool.submit([this, texture, faces, background]() {
+			std::shared_ptr<TextureUpload> upload = std::make_shared<TextureUpload>();
+			std::shared_ptr<TextureStream> stream;
+			std::vector<std::shared_ptr<AssetFile>> baked(faces.size());
+			std::vector<const TextureFileHeader*> headers(faces.size(), nullptr);
+			pool.parallelFor(faces.size(), [&](size_t i) {
+				baked[i] = loadBaked(faces[i].first, false, headers[i]);
+			});
+			bool complete = true;
+			for (size_t i = 0; i < faces.size(); i++) {
+				complete = complete && baked[i] && headers[i]->width == headers[0]->width && headers[i]->height == headers[0]->height &&
+					headers[i]->internalFormat == headers[0]->internalFormat && headers[i]->levelCount == headers[0]->levelCount;
+			}
+			if (complete) {
+				GLint first = faces.empty() ? 0 : tailLevel(*headers[0]);
+				std::vector<GLenum> targets;
+				for (size_t i = 0; i < faces.size(); i++) {
+					addBaked(*upload, faces[i].second, baked[i], *headers[i], first);
+					targets.push_back(faces[i].second);
+				}
+				if (first > 0) {
+					stream = makeStream(texture, baked, headers, targets, first);
+				}
+			}
+			else {
+				std::vector<std::shared_ptr<Image>> images(faces.size());
+				pool.parallelFor(faces.size(), [&](size_t i) {
+					images[i] = decode(faces[i].first, false);
+				});
+				for (const std::shared_ptr<Image>& image : images) {
+					if (!image->pixels || image->width != images[0]->width || image->height != images[0]->height) {
+						std::cout << "ERROR::ASSET_LOADER::CUBEMAP_NOT_LOADED: " << faces[0].first << std::endl;
+						enqueue([]() {}, !background);
+						return;
+					}
+				}
+				for (size_t i = 0; i < faces.size(); i++) {
+					addImage(*upload, faces[i].second, images[i], GL_RGB);
+				}
+			}
+			stage(*upload);
+			deliver(texture, upload, stream, !background);
+		}));
+		return texture;
+	}
+
+	// GL_TEXTURE_2D_ARRAY with one layer per image, each resized to width x height where it differs, mipmapped like
+	// loadTexture. Objects that pick their layer in the shader draw without binding a texture in between
+	std::shared_ptr<Texture> loadTextureArray(const std::vector<std::string>& paths, int width, int height) {
+		std::shared_ptr<Texture> texture = std::make_shared<Texture>(GL_TEXTURE_2D_ARRAY, GL_RGB, paths.empty() ? std::string() : paths[0]);
+		createPlaceholder(*texture, {}, paths.size());
+		startStreaming();
+
+		requested++;
+		jobs.push_back(pool.submit([this, texture, paths, width, height]() {
+			std::vector<std::shared_ptr<Image>> images(paths.size());
+			pool.parallelFor(paths.size(), [&](size_t i) {
+				images[i] = resize(decode(paths[i], true), width, height);
+			});
+			std::shared_ptr<TextureUpload> upload = std::make_shared<TextureUpload>();
+			for (size_t i = 0; i < images.size(); i++) {
+				if (!images[i]->pixels) {
+					enqueue([]() {});
+					return;
+				}
+				addImage(*upload, GL_TEXTURE_2D_ARRAY, images[i], texture->internalFormat);
+				upload->levels.back().layer = GLint(i);
+			}
+			upload->layerCount = GLsizei(images.size());
+			upload->levelCount = mipLevels(width, height);
+			upload->generateMipmap = true;
+			stage(*upload);
+			deliver(texture, upload, nullptr, true);
+		}));
+		return texture;
+	}
+
+	// Uploads finished assets until budgetSeconds are used up, at least one per call so loading always progresses,
+	// then copies up to budgetBytes from client memory: first of the uploads the ring could not hold, the rest of
+	// finer mip levels. Call once per frame on the thread that owns the GL context
+	void update(double budgetSeconds, size_t budgetBytes = STREAM_BUDGET) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		ring.retire();
+		while (true) {
+			Ready item;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (ready.empty()) {
+					break;
+				}
+				item = std::move(ready.front());
+				ready.pop_front();
+			}
+			item.upload();
+			completed += item.counted ? 1 : 0;
+			if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() >= budgetSeconds) {
+				break;
+			}
+		}
+		size_t spent = commitPieces(budgetBytes);
+		if (spent < budgetBytes) {
+			refine(budgetBytes - spent);
+		}
+		// forget the finished jobs, background ones may still be running
+		jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](const std::future<void>& job) {
+			return job.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		}), jobs.end());
+	}
+
+	bool done() const {
+		return completed == requested;
+	}
+
+	// textures that still miss some of their finer mip levels or are still being copied
+	size_t streaming() const {
+		return streams.size() + committing.size();
+	}
+
+	float progress() const {
+		return requested == 0 ? 1.0f : float(completed) / float(requested);
+	}
+
+	// progress bar along the bottom of the framebuffer, drawn with scissored clears so it needs no shader
+	void drawProgress(int width, int height) {
+		if (done()) {
+			return;
+		}
+		int margin = width / 10;
+		int barHeight = std::max(height / 50, 4);
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(margin, margin, width - 2 * margin, barHeight);
+		glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glScissor(margin, margin, static_cast<GLsizei>((width - 2 * margin) * progress()), barHeight);
+		glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glDisable(GL_SCISSOR_TEST);
+	}
+
+private:
+	struct Image {
+		int width = 0, height = 0;
+		std::shared_ptr<unsigned char> pixels;		// tightly packed RGB rows
+	};
+
+	// One level of one face, read from pixels or, once staged, from the upload ring at offset
+	struct TextureLevel {
+		GLenum target;		// GL_TEXTURE_2D or a cube map face
+		GLint level;
+		GLsizei width, height;
+		size_t size;
+		const char* pixels;
+		size_t offset;
+		GLint layer = -1;		// of a GL_TEXTURE_2D_ARRAY
+	};
+
+	// Everything a texture gets once its data arrived, prepared on a loader thread
+	struct TextureUpload {
+		GLenum internalFormat = GL_RGB;		// the requested format, or the compressed one of a .vrtex
+		bool compressed = false;
+		GLsizei width = 0, height = 0;
+		GLsizei levelCount = 1;		// levels to allocate, more than given when generateMipmap is set
+		GLsizei layerCount = 0;		// 0 unless the texture is an array
+		bool generateMipmap = false;
+		GLint baseLevel = 0;		// the coarsest levels given, the finer ones are streamed afterwards
+		size_t compressedBytes = 0;		// all levels of a .vrtex, including the streamed ones
+		std::vector<TextureLevel> levels;
+		std::vector<std::shared_ptr<void>> sources;		// keep pixels alive until the upload, unless it was staged
+		UploadRegion region;
+	};
+
+	static const size_t UPLOAD_RING_SIZE = 32 * 1024 * 1024;		// fits every baked cube map; larger uploads are copied piecewise
+	static const int STREAM_TAIL_SIZE = 64;		// baked levels up to this size are uploaded at once, the rest is streamed
+	static const size_t STREAM_BUDGET = 1024 * 1024;		// bytes copied from client memory per frame
+
+	// The finer levels of a baked texture that are still missing. The loader threads stage the next one into the ring,
+	// the main thread copies it a few block rows at a time
+	struct TextureStream {
+		std::weak_ptr<Texture> texture;		// the stream ends when the texture is freed
+		std::vector<std::shared_ptr<AssetFile>> files;		// per face
+		std::vector<const TextureFileHeader*> headers;
+		std::vector<GLenum> targets;
+		GLint baseLevel;		// the finest level complete on the GPU
+		std::shared_ptr<TextureUpload> staged;		// level baseLevel - 1 of every face, once staged
+		bool staging = false;
+		size_t face = 0;		// copy position in staged
+		GLsizei row = 0;		// in block rows
+	};
+
+	// An upload that was not staged, copied into texture id a few rows per frame. The handle keeps its previous texture
+	// until every level is there
+	struct Piecewise {
+		std::shared_ptr<Texture> texture;
+		std::shared_ptr<TextureUpload> upload;
+		std::shared_ptr<TextureStream> stream;		// started once the copy is done
+		bool counted;
+		GLuint id = 0;		// 0 until the storage is allocated
+		size_t level = 0;		// copy position in upload
+		GLsizei row = 0;
+	};
+
+	// an upload waiting for the main thread
+	struct Ready {
+		std::function<void()> upload;
+		bool counted;		// towards progress(), false for background loads
+	};
+
+	ThreadPool& pool;
+	std::vector<std::future<void>> jobs;
+	std::mutex mutex;
+	std::deque<Ready> ready;
+	size_t requested = 0;
+	size_t completed = 0;
+	GLuint pixelBuffer = 0;
+	UploadRing ring;
+	bool ringCreated = false;
+	std::vector<std::shared_ptr<TextureStream>> streams;
+	std::deque<Piecewise> committing;
+
+	static const unsigned char* placeholder() {
+		static const unsigned char grey[4] = { 128, 128, 128, 0 };
+		return grey;
+	}
+
+	void enqueue(std::function<void()> upload, bool counted = true) {
+		std::lock_guard<std::mutex> lock(mutex);
+		ready.push_back(Ready{ std::move(upload), counted });
+	}
+
+	// The .vrtex baked from path (see TextureBaker), nullptr if there is none that is up to date or the driver
+	// cannot sample S3TC. Its levels are uploaded as they are, without decoding the image
+	static std::shared_ptr<AssetFile> loadBaked(const std::string& path, bool flip, const TextureFileHeader*& header) {
+		header = nullptr;
+		if (!GLAD_GL_EXT_texture_compression_s3tc) {
+			return nullptr;
+		}
+		ProfileScope loading("load baked", "texture", path);
+		return TextureFile::load(path, flip, header);
+	}
+
+	static std::shared_ptr<Image> decode(const std::string& path, bool flip) {
+		ProfileScope decoding("decode", "texture", path);
+		std::shared_ptr<Image> image = std::make_shared<Image>();
+		stbi_set_flip_vertically_on_load_thread(flip);
+		int channels;
+		unsigned char* data = nullptr;
+		const char* reason = "can't open file";
+		AssetFile file;		// from the asset pack if it holds the image
+		if (file.open(path.c_str()) && file.data() != nullptr) {
+			data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()), static_cast<int>(file.size()),
+				&image->width, &image->height, &channels, STBI_rgb);
+			reason = stbi_failure_reason();
+		}
+		if (data == nullptr) {
+			std::cout << "ERROR::ASSET_LOADER::TEXTURE_NOT_LOADED: " << path << " (" << (reason == nullptr ? "unknown" : reason) << ")" << std::endl;
+			return image;
+		}
+		image->pixels = std::shared_ptr<unsigned char>(data, stbi_image_free);
+		return image;
+	}
+
+	// main thread, before the first texture job: the ring needs the GL context
+	void startStreaming() {
+		if (!ringCreated) {
+			ringCreated = true;
+			ring.create(UPLOAD_RING_SIZE);
+		}
+	}
+
+	// the wrapping the textures always had, trilinear filtering once there are mips to filter between
+	static void setSampling(GLenum target, GLsizei levelCount = 1) {
+		GLint wrap = target == GL_TEXTURE_CUBE_MAP ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap);
+		glTexParameteri(target, GL_TEXTURE_WRAP_R, wrap);
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levelCount - 1);		// a mutable texture is complete with just these
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+
+	// one grey texel per face, or per layer of an array
+	static void createPlaceholder(Texture& texture, const std::vector<GLenum>& faces, size_t layers = 0) {
+		texture.bind();
+		setSampling(texture.target);
+		for (GLenum face : faces) {
+			glTexImage2D(face, 0, texture.internalFormat, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, placeholder());
+		}
+		if (layers > 0) {
+			std::vector<unsigned char> grey(layers * 4, 128);		// rows padded to 4 bytes
+			glTexImage3D(texture.target, 0, texture.internalFormat, 1, 1, GLsizei(layers), 0, GL_RGB, GL_UNSIGNED_BYTE, grey.data());
+		}
+		texture.gpuBytes = Texture::bytesOf(texture.internalFormat, 1, 1, false) * (faces.size() + layers);
+	}
+
+	static GLsizei mipLevels(int width, int height) {
+		GLsizei levels = 1;
+		for (int size = std::max(width, height); size > 1; size /= 2) {
+			levels++;
+		}
+		return levels;
+	}
+
+	// The first level of a baked texture uploaded right away: the largest one of at most STREAM_TAIL_SIZE. Always 0 for
+	// mutable textures, a texture is only streamed into immutable storage that already holds every level
+	static GLint tailLevel(const TextureFileHeader& header) {
+		if (!GLAD_GL_ARB_texture_storage) {
+			return 0;
+		}
+		GLint level = 0;
+		uint32_t width = header.width, height = header.height;
+		while (std::max(width, height) > uint32_t(STREAM_TAIL_SIZE) && level + 1 < GLint(header.levelCount)) {
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+			level++;
+		}
+		return level;
+	}
+
+	// levels first and coarser of the .vrtex, the finer ones are left to a TextureStream
+	static void addBaked(TextureUpload& upload, GLenum target, const std::shared_ptr<AssetFile>& file, const TextureFileHeader& header, GLint first = 0) {
+		upload.internalFormat = header.internalFormat;
+		upload.compressed = true;
+		upload.width = header.width;
+		upload.height = header.height;
+		upload.levelCount = header.levelCount;
+		upload.baseLevel = first;
+		for (uint32_t i = 0; i < header.levelCount; i++) {
+			const TextureFileLevel& level = TextureFile::level(*file, header, i);
+			upload.compressedBytes += size_t(level.size);
+			if (GLint(i) < first) {
+				continue;
+			}
+			upload.levels.push_back(TextureLevel{ target, GLint(i), GLsizei(level.width), GLsizei(level.height), size_t(level.size),
+				TextureFile::levelData(*file, level), 0 });
+		}
+		upload.sources.push_back(file);
+	}
+
+	static void addImage(TextureUpload& upload, GLenum target, const std::shared_ptr<Image>& image, GLenum internalFormat) {
+		upload.internalFormat = internalFormat;
+		upload.width = image->width;
+		upload.height = image->height;
+		upload.levels.push_back(TextureLevel{ target, 0, image->width, image->height, size_t(image->width) * image->height * 3,
+			reinterpret_cast<const char*>(image->pixels.get()), 0 });
+		upload.sources.push_back(image);
+	}
+
+	// the image scaled to width x height, filtered in sRGB space like the baked mips
+	static std::shared_ptr<Image> resize(const std::shared_ptr<Image>& image, int width, int height) {
+		if (!image->pixels || (image->width == width && image->height == height)) {
+			return image;
+		}
+		ProfileScope resizing("resize", "texture");
+		std::shared_ptr<Image> resized = std::make_shared<Image>();
+		resized->width = width;
+		resized->height = height;
+		resized->pixels = std::shared_ptr<unsigned char>(new unsigned char[size_t(width) * height * 3], std::default_delete<unsigned char[]>());
+		stbir_resize_uint8_srgb(image->pixels.get(), image->width, image->height, 0, resized->pixels.get(), width, height, 0, 3,
+			STBIR_ALPHA_CHANNEL_NONE, 0);
+		return resized;
+	}
+
+	// Loader thread: copies every level into one region of the ring, so the main thread only issues the copies.
+	// Without the ring, or when it can never hold the upload, the levels stay where they are
+	void stage(TextureUpload& upload) {
+		size_t total = 0;
+		for (const TextureLevel& level : upload.levels) {
+			total += (level.size + UploadRing::ALIGNMENT - 1) / UploadRing::ALIGNMENT * UploadRing::ALIGNMENT;
+		}
+		upload.region = ring.reserve(total);
+		if (!upload.region) {
+			return;
+		}
+		ProfileScope staging("stage texture", "texture");
+		size_t offset = 0;
+		for (TextureLevel& level : upload.levels) {
+			std::memcpy(upload.region.data + offset, level.pixels, level.size);
+			level.offset = upload.region.offset + offset;
+			level.pixels = nullptr;
+			offset += (level.size + UploadRing::ALIGNMENT - 1) / UploadRing::ALIGNMENT * UploadRing::ALIGNMENT;
+		}
+		upload.sources.clear();
+	}
+
+	// Loader thread: hands the upload to the main thread. A staged one is committed at once, the GPU copies it from the
+	// ring; one that stayed in client memory is copied piecewise by update, so no frame copies all of it
+	void deliver(const std::shared_ptr<Texture>& texture, const std::shared_ptr<TextureUpload>& upload, const std::shared_ptr<TextureStream>& stream, bool counted) {
+		if (!upload->region) {
+			enqueue([this, texture, upload, stream, counted]() {
+				committing.push_back(Piecewise{ texture, upload, stream, counted });
+			}, false);
+			return;
+		}
+		enqueue([this, texture, upload, stream]() {
+			ProfileScope uploading("upload texture", "gl", texture->path);
+			commit(*texture, *upload);
+			if (stream) {
+				streams.push_back(stream);
+			}
+		}, counted);
+	}
+
+	// Main thread: the whole upload at once
+	void commit(Texture& texture, const TextureUpload& upload) {
+		GLuint id = allocate(texture, upload);
+		for (const TextureLevel& level : upload.levels) {
+			copyRows(texture.target, upload, level, 0, rowCount(upload, level));
+		}
+		if (upload.region) {
+			ring.release(upload.region);
+		}
+		finish(texture, upload, id);
+	}
+
+	// Main thread: continues the piecewise uploads, oldest first, until budgetBytes are copied, at least one row so
+	// they always progress. Returns the bytes copied
+	size_t commitPieces(size_t budgetBytes) {
+		size_t spent = 0;
+		while (!committing.empty() && (spent == 0 || spent < budgetBytes)) {
+			Piecewise& piece = committing.front();
+			ProfileScope uploading("upload texture rows", "gl", piece.texture->path);
+			const TextureUpload& upload = *piece.upload;
+			if (piece.id == 0) {
+				piece.id = allocate(*piece.texture, upload);
+			}
+			else {
+				glBindTexture(piece.texture->target, piece.id);
+			}
+			while (piece.level < upload.levels.size() && (spent == 0 || spent < budgetBytes)) {
+				const TextureLevel& level = upload.levels[piece.level];
+				GLsizei total = rowCount(upload, level);
+				size_t bytes = rowBytes(upload, level);
+				size_t left = spent < budgetBytes ? budgetBytes - spent : 0;
+				GLsizei rows = std::min(total - piece.row, GLsizei(std::max(left / bytes, size_t(1))));
+				copyRows(piece.texture->target, upload, level, piece.row, rows);
+				spent += size_t(rows) * bytes;
+				piece.row += rows;
+				if (piece.row == total) {
+					piece.row = 0;
+					piece.level++;
+				}
+			}
+			if (piece.level < upload.levels.size()) {
+				break;
+			}
+			finish(*piece.texture, upload, piece.id);
+			completed += piece.counted ? 1 : 0;
+			if (piece.stream) {
+				streams.push_back(piece.stream);
+			}
+			committing.pop_front();
+		}
+		return spent;
+	}
+
+	// Main thread: a new texture name with storage for every level of upload, bound. With GL_ARB_texture_storage it is
+	// immutable, otherwise each given level is specified without data. It replaces the placeholder behind the handle
+	// in finish, so the placeholder is drawn until the copies are done
+	GLuint allocate(Texture& texture, const TextureUpload& upload) {
+		GLuint id = 0;
+		glGenTextures(1, &id);
+		glBindTexture(texture.target, id);
+		setSampling(texture.target, upload.levelCount);
+		if (GLAD_GL_ARB_texture_storage) {
+			GLenum format = upload.compressed ? upload.internalFormat : Texture::sizedFormat(upload.internalFormat);
+			if (upload.layerCount > 0) {
+				glTexStorage3D(texture.target, upload.levelCount, format, upload.width, upload.height, upload.layerCount);
+			}
+			else {
+				glTexStorage2D(texture.target, upload.levelCount, format, upload.width, upload.height);
+			}
+			return id;
+		}
+		if (upload.layerCount > 0) {
+			glTexImage3D(texture.target, 0, upload.internalFormat, upload.width, upload.height, upload.layerCount, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+			return id;
+		}
+		for (const TextureLevel& level : upload.levels) {
+			if (upload.compressed) {
+				glCompressedTexImage2D(level.target, level.level, upload.internalFormat, level.width, level.height, 0, GLsizei(level.size), nullptr);
+			}
+			else {
+				glTexImage2D(level.target, level.level, upload.internalFormat, level.width, level.height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+			}
+		}
+		return id;
+	}
+
+	// rows of a level as they are copied: texel rows, or rows of 4x4 blocks for a compressed format
+	static GLsizei rowCount(const TextureUpload& upload, const TextureLevel& level) {
+		return upload.compressed ? (level.height + 3) / 4 : level.height;
+	}
+
+	static size_t rowBytes(const TextureUpload& upload, const TextureLevel& level) {
+		return upload.compressed ? TextureFile::levelSize(upload.internalFormat, level.width, 4) : size_t(level.width) * 3;
+	}
+
+	// Main thread: copies rows [row, row + rows) of level into the bound texture, from the ring when the upload was
+	// staged, through the pixel buffer otherwise
+	void copyRows(GLenum target, const TextureUpload& upload, const TextureLevel& level, GLsizei row, GLsizei rows) {
+		GLsizei rowHeight = upload.compressed ? 4 : 1;
+		GLint y = row * rowHeight;
+		GLsizei height = std::min(rows * rowHeight, level.height - y);
+		size_t skip = size_t(row) * rowBytes(upload, level);
+		size_t bytes = size_t(rows) * rowBytes(upload, level);
+		const void* pixels = upload.region ? reinterpret_cast<const void*>(level.offset + skip) : stream(level.pixels + skip, bytes);
+		if (upload.region) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.name());
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		if (level.layer >= 0) {
+			glTexSubImage3D(target, level.level, 0, y, level.layer, level.width, height, 1, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+		}
+		else if (upload.compressed) {
+			glCompressedTexSubImage2D(level.target, level.level, 0, y, level.width, height, upload.internalFormat, GLsizei(bytes), pixels);
+		}
+		else {
+			glTexSubImage2D(level.target, level.level, 0, y, level.width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	// Main thread, once every level is in texture id: mipmaps it and puts it behind the handle
+	void finish(Texture& texture, const TextureUpload& upload, GLuint id) {
+		glBindTexture(texture.target, id);
+		if (upload.generateMipmap) {
+			glGenerateMipmap(texture.target);
+		}
+		if (upload.baseLevel > 0) {
+			glTexParameteri(texture.target, GL_TEXTURE_BASE_LEVEL, upload.baseLevel);
+		}
+		glDeleteTextures(1, &texture.id);
+		texture.id = id;
+		texture.loaded = true;
+
+		if (upload.compressed) {
+			texture.gpuBytes = upload.compressedBytes;
+		}
+		else {
+			// one level per face or layer, the mips are generated
+			texture.gpuBytes = Texture::bytesOf(upload.internalFormat, upload.width, upload.height, upload.generateMipmap) * upload.levels.size();
+		}
+	}
+
+	static std::shared_ptr<TextureStream> makeStream(const std::shared_ptr<Texture>& texture, const std::vector<std::shared_ptr<AssetFile>>& files,
+		const std::vector<const TextureFileHeader*>& headers, const std::vector<GLenum>& targets, GLint baseLevel) {
+		std::shared_ptr<TextureStream> stream = std::make_shared<TextureStream>();
+		stream->texture = texture;
+		stream->files = files;
+		stream->headers = headers;
+		stream->targets = targets;
+		stream->baseLevel = baseLevel;
+		return stream;
+	}
+
+	// main thread: a loader thread copies the next finer level of every face into the ring
+	void prefetch(const std::shared_ptr<TextureStream>& stream) {
+		stream->staging = true;
+		GLint next = stream->baseLevel - 1;
+		jobs.push_back(pool.submit([this, stream, next]() {
+			std::shared_ptr<TextureUpload> upload = std::make_shared<TextureUpload>();
+			upload->internalFormat = stream->headers[0]->internalFormat;
+			upload->compressed = true;
+			for (size_t i = 0; i < stream->files.size(); i++) {
+				const TextureFileLevel& level = TextureFile::level(*stream->files[i], *stream->headers[i], uint32_t(next));
+				upload->levels.push_back(TextureLevel{ stream->targets[i], next, GLsizei(level.width), GLsizei(level.height), size_t(level.size),
+					TextureFile::levelData(*stream->files[i], level), 0 });
+			}
+			stage(*upload);
+			enqueue([stream, upload]() {
+				stream->staged = upload;
+				stream->staging = false;
+			}, false);
+		}));
+	}
+
+	// Main thread: copies staged levels until budgetBytes are used, at least one block row so streaming always
+	// progresses. Levels a texture is still waiting for are requested, finished and freed streams are dropped
+	void refine(size_t budgetBytes) {
+		size_t spent = 0;
+		for (std::shared_ptr<TextureStream>& pending : streams) {
+			std::shared_ptr<Texture> texture = pending->texture.lock();
+			if (!texture) {
+				if (pending->staged && pending->staged->region) {
+					ring.release(pending->staged->region);
+				}
+				pending->staged.reset();
+				pending->baseLevel = 0;
+				continue;
+			}
+			if (!pending->staged && !pending->staging && pending->baseLevel > 0) {
+				prefetch(pending);
+			}
+			if (!pending->staged || spent >= std::max(budgetBytes, size_t(1))) {
+				continue;
+			}
+			ProfileScope streaming("stream texture", "gl");
+			const TextureUpload& upload = *pending->staged;
+			glBindTexture(texture->target, texture->id);
+			while (pending->face < upload.levels.size() && (spent == 0 || spent < budgetBytes)) {
+				const TextureLevel& level = upload.levels[pending->face];
+				GLsizei blockRows = rowCount(upload, level);
+				size_t bytes = rowBytes(upload, level);
+				size_t left = spent < budgetBytes ? budgetBytes - spent : 0;
+				GLsizei rows = std::min(blockRows - pending->row, GLsizei(std::max(left / bytes, size_t(1))));
+				copyRows(texture->target, upload, level, pending->row, rows);
+				spent += size_t(rows) * bytes;
+				pending->row += rows;
+				if (pending->row == blockRows) {
+					pending->row = 0;
+					pending->face++;
+				}
+			}
+			if (pending->face == upload.levels.size()) {
+				// every face has the level, the texture may sample it
+				if (upload.region) {
+					ring.release(upload.region);
+				}
+				pending->baseLevel--;
+				glTexParameteri(texture->target, GL_TEXTURE_BASE_LEVEL, pending->baseLevel);
+				pending->staged.reset();
+				pending->face = 0;
+				if (pending->baseLevel > 0) {
+					prefetch(pending);
+				}
+			}
+		}
+		streams.erase(std::remove_if(streams.begin(), streams.end(), [](const std::shared_ptr<TextureStream>& stream) {
+			return stream->baseLevel == 0 && !stream->staging;
+		}), streams.end());
+	}
+
+	// Fallback without the ring: copies the level into the pixel buffer and lets the GL read it from there, so the
+	// texture call does not have to copy from client memory while the main thread waits. Orphaning the buffer keeps
+	// earlier uploads intact. Leaves the buffer bound and returns the offset to pass, or pixels if mapping failed
+	const void* stream(const char* pixels, size_t bytes) {
+		if (pixelBuffer == 0) {
+			glGenBuffers(1, &pixelBuffer);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+		void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (mapped == nullptr) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			return pixels;
+		}
+		std::memcpy(mapped, pixels, bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		return nullptr;
+	}
+};
+#endif
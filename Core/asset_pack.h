@@ -0,0 +1,307 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "lz4_block.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+// Header of a .vrpack file: every asset of the application in one file, so startup opens one file instead of dozens.
+// It is followed by the table of contents (AssetPackEntry, sorted by name), the names and the data of each asset,
+// every blob starting at a 64 byte aligned offset
+struct AssetPackHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t entryCount;
+	uint32_t entrySize;
+	uint64_t tocOffset;
+	uint64_t namesOffset;
+	uint64_t namesSize;
+	uint64_t tocHash;		// hash of the table of contents and the names, which follow it directly
+};
+
+// One asset. A compressed one starts with a uint32_t per block (its compressed size, with COMPRESSED_BLOCK unset
+// when the block did not shrink and is stored as is), followed by the blocks. Each block holds BLOCK_SIZE bytes
+// of the asset, the last one the rest
+struct AssetPackEntry {
+	uint64_t nameOffset;		// into the names, which are not zero terminated
+	uint64_t dataOffset;
+	uint64_t storedSize;		// bytes in the pack
+	uint64_t size;				// bytes of the asset
+	int64_t mtime;				// of the file that was packed
+	uint64_t hash;				// AssetPack::hashBytes of the asset, as MeshCache compares it
+	uint32_t nameLength;
+	uint32_t flags;
+	uint32_t blockCount;		// 0 when stored uncompressed
+	uint32_t reserved;
+};
+
+static_assert(sizeof(AssetPackEntry) == 64, "AssetPackEntry is stored as is in the .vrpack");
+
+// Read only view of a mapped .vrpack. Assets are looked up by their path relative to the directory the pack was
+// built from, e.g. "objects/meeple.obj", with a binary search over the table of contents
+class AssetPack
+{
+public:
+	static const uint32_t VERSION = 1;
+	static const uint32_t COMPRESSED = 1;				// AssetPackEntry::flags
+	static const uint32_t COMPRESSED_BLOCK = 0x80000000u;
+	static const size_t BLOCK_SIZE = 64 * 1024;
+	static const size_t ALIGNMENT = 64;
+
+	// The pack the loaders consult, see AssetFile. Mount it once at startup, before any asset is loaded
+	static AssetPack& shared() {
+		static AssetPack pack;
+		return pack;
+	}
+
+	// Maps the pack. Absolute paths below root are looked up by their part after root, so the compile time paths
+	// of the assets keep working when the binary and its pack live somewhere else
+	bool mount(const std::string& path, const std::string& root) {
+		file.close();
+		header = nullptr;
+		if (!file.open(path.c_str())) {
+			return false;
+		}
+		const AssetPackHeader* h = reinterpret_cast<const AssetPackHeader*>(file.data());
+		if (file.size() < sizeof(AssetPackHeader) || std::memcmp(h->magic, "VRPACK\0", 8) != 0 || h->version != VERSION ||
+			h->headerSize != sizeof(AssetPackHeader) || h->entrySize != sizeof(AssetPackEntry) ||
+			h->tocOffset % 8 != 0 || h->namesOffset != h->tocOffset + uint64_t(h->entryCount) * sizeof(AssetPackEntry) ||
+			h->namesOffset + h->namesSize > file.size()) {
+			std::cout << "ERROR::ASSET_PACK::INVALID: " << path << std::endl;
+			return false;
+		}
+		const char* toc = file.data() + h->tocOffset;
+		if (hashBytes(toc, h->namesOffset + h->namesSize - h->tocOffset) != h->tocHash) {
+			std::cout << "ERROR::ASSET_PACK::CORRUPT: " << path << std::endl;
+			return false;
+		}
+		const AssetPackEntry* entries = reinterpret_cast<const AssetPackEntry*>(toc);
+		for (uint32_t i = 0; i < h->entryCount; i++) {
+			const AssetPackEntry& e = entries[i];
+			if (e.nameOffset + e.nameLength > h->namesSize || e.dataOffset + e.storedSize > file.size() ||
+				((e.flags & COMPRESSED) != 0) != (e.blockCount != 0) || uint64_t(e.blockCount) * 4 > e.storedSize) {
+				std::cout << "ERROR::ASSET_PACK::INVALID: " << path << std::endl;
+				return false;
+			}
+		}
+		header = h;
+		prefix = root.empty() || root.back() == '/' ? root : root + "/";
+		return true;
+	}
+
+	bool mounted() const {
+		return header != nullptr;
+	}
+
+	size_t size() const {
+		return header == nullptr ? 0 : header->entryCount;
+	}
+
+	const AssetPackEntry& entry(size_t i) const {
+		return entries()[i];
+	}
+
+	std::string name(const AssetPackEntry& e) const {
+		return std::string(names() + e.nameOffset, e.nameLength);
+	}
+
+	// the entry for path (absolute below root, or already relative), nullptr if the pack does not hold it
+	const AssetPackEntry* find(const std::string& path) const {
+		if (header == nullptr) {
+			return nullptr;
+		}
+		const char* key = path.c_str();
+		size_t keyLength = path.size();
+		if (!prefix.empty() && path.compare(0, prefix.size(), prefix) == 0) {
+			key += prefix.size();
+			keyLength -= prefix.size();
+		}
+		const AssetPackEntry* begin = entries();
+		const AssetPackEntry* end = begin + header->entryCount;
+		const AssetPackEntry* found = std::lower_bound(begin, end, std::make_pair(key, keyLength),
+			[this](const AssetPackEntry& e, const std::pair<const char*, size_t>& k) {
+				return compare(names() + e.nameOffset, e.nameLength, k.first, k.second) < 0;
+			});
+		if (found == end || compare(names() + found->nameOffset, found->nameLength, key, keyLength) != 0) {
+			return nullptr;
+		}
+		return found;
+	}
+
+	// the bytes as stored, which are the asset itself unless it is compressed
+	const char* stored(const AssetPackEntry& e) const {
+		return file.data() + e.dataOffset;
+	}
+
+	// Decompresses e into out (size bytes). Large assets decompress their blocks in parallel on the shared pool
+	bool unpack(const AssetPackEntry& e, char* out) const {
+		const char* data = stored(e);
+		if ((e.flags & COMPRESSED) == 0) {
+			std::memcpy(out, data, e.size);
+			return true;
+		}
+		std::vector<uint64_t> offsets(e.blockCount + 1);
+		offsets[0] = uint64_t(e.blockCount) * 4;
+		for (uint32_t b = 0; b < e.blockCount; b++) {
+			uint32_t blockSize;
+			std::memcpy(&blockSize, data + b * 4, 4);
+			offsets[b + 1] = offsets[b] + (blockSize & ~COMPRESSED_BLOCK);
+		}
+		if (offsets.back() > e.storedSize || (e.size + BLOCK_SIZE - 1) / BLOCK_SIZE != e.blockCount) {
+			return false;
+		}
+		std::vector<char> failed(e.blockCount, 0);
+		auto block = [&](size_t b) {
+			uint32_t blockSize;
+			std::memcpy(&blockSize, data + b * 4, 4);
+			size_t outSize = std::min<uint64_t>(BLOCK_SIZE, e.size - b * BLOCK_SIZE);
+			size_t inSize = offsets[b + 1] - offsets[b];
+			if (blockSize & COMPRESSED_BLOCK) {
+				failed[b] = !Lz4Block::decompress(data + offsets[b], inSize, out + b * BLOCK_SIZE, outSize);
+			}
+			else if (inSize == outSize) {
+				std::memcpy(out + b * BLOCK_SIZE, data + offsets[b], outSize);
+			}
+			else {
+				failed[b] = 1;
+			}
+		};
+		if (e.blockCount >= PARALLEL_BLOCKS) {
+			ThreadPool::shared().parallelFor(e.blockCount, block);
+		}
+		else {
+			for (size_t b = 0; b < e.blockCount; b++) {
+				block(b);
+			}
+		}
+		return std::find(failed.begin(), failed.end(), 1) == failed.end();
+	}
+
+	// 64 bit FNV style hash consuming 8 bytes per step
+	static uint64_t hashBytes(const char* data, size_t size) {
+		uint64_t hash = 0xcbf29ce484222325ull ^ size;
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			std::memcpy(&word, data + i, 8);
+			hash = (hash ^ word) * 0x100000001b3ull;
+			hash ^= hash >> 29;
+		}
+		for (; i < size; i++) {
+			hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	static int compare(const char* a, size_t aLength, const char* b, size_t bLength) {
+		int order = std::memcmp(a, b, std::min(aLength, bLength));
+		return order != 0 ? order : (aLength < bLength ? -1 : (aLength > bLength ? 1 : 0));
+	}
+
+private:
+	static const uint32_t PARALLEL_BLOCKS = 16;		// 1 MiB, below that one thread is faster than handing out the blocks
+
+	MappedFile file;
+	const AssetPackHeader* header = nullptr;
+	std::string prefix;
+
+	const AssetPackEntry* entries() const {
+		return reinterpret_cast<const AssetPackEntry*>(file.data() + header->tocOffset);
+	}
+
+	const char* names() const {
+		return file.data() + header->namesOffset;
+	}
+};
+
+// The bytes of one asset: from the mounted AssetPack when it holds the path, from the file on disk otherwise.
+// With preferEdited set, a file on disk whose size or modification time differs from the packed one was edited after
+// the pack was built and wins over it; that costs a stat per asset, so it is meant for working on the assets.
+// Uncompressed pack entries and disk files are mapped, compressed entries are unpacked on the first call to data()
+class AssetFile
+{
+public:
+	AssetFile() {}
+
+	AssetFile(const AssetFile&) = delete;
+	AssetFile& operator=(const AssetFile&) = delete;
+
+	// when set, edited files on disk are read instead of their packed copies, like MeshCache::forceRebuild
+	static bool& preferEdited() {
+		static bool prefer = false;
+		return prefer;
+	}
+
+	bool open(const char* path) {
+		entry = AssetPack::shared().find(path);
+		if (entry != nullptr && preferEdited() && edited(path, *entry)) {
+			entry = nullptr;
+		}
+		if (entry != nullptr) {
+			length = static_cast<size_t>(entry->size);
+			bytes = (entry->flags & AssetPack::COMPRESSED) ? nullptr : AssetPack::shared().stored(*entry);
+			return true;
+		}
+		if (!file.open(path)) {
+			return false;
+		}
+		bytes = file.data();
+		length = file.size();
+		return true;
+	}
+
+	bool isOpen() const {
+		return entry != nullptr || bytes != nullptr;
+	}
+
+	const char* data() const {
+		if (bytes == nullptr && entry != nullptr) {
+			unpacked.resize(length);
+			if (!AssetPack::shared().unpack(*entry, unpacked.data())) {
+				std::cout << "ERROR::ASSET_PACK::CORRUPT_ENTRY: " << AssetPack::shared().name(*entry) << std::endl;
+				unpacked.clear();
+				length = 0;
+				return nullptr;
+			}
+			bytes = unpacked.data();
+		}
+		return bytes;
+	}
+
+	const char* end() const {
+		const char* begin = data();
+		return begin == nullptr ? nullptr : begin + length;
+	}
+
+	size_t size() const { return length; }
+	bool empty() const { return length == 0; }
+
+	// the pack entry the bytes come from, nullptr for a file on disk
+	const AssetPackEntry* packEntry() const { return entry; }
+
+private:
+	MappedFile file;
+	const AssetPackEntry* entry = nullptr;
+	mutable std::vector<char> unpacked;
+	mutable const char* bytes = nullptr;
+	mutable size_t length = 0;
+
+	static bool edited(const char* path, const AssetPackEntry& packed) {
+		struct stat info;
+		if (stat(path, &info) != 0) {
+			return false;		// shipped without the loose files
+		}
+		return static_cast<uint64_t>(info.st_size) != packed.size || static_cast<int64_t>(info.st_mtime) != packed.mtime;
+	}
+};
+#endif
@@ -0,0 +1,130 @@
+// Statistics of the mesh pipeline for .obj files, without an OpenGL context:
+// triangles and geometric error of every level of detail MeshSimplifier builds, and the post transform
+// cache efficiency (ACMR/ATVR) of the index buffers before and after MeshOptimizer.
+// Exits with 1 when a file cannot be read, a level does not have fewer triangles than the one before it, or the
+// measured error of a level exceeds the bound the simplifier reported for it.
+// Usage: MeshReport [file.obj ...]   (defaults to the .obj files in objects/)
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bounds.h"
+#include "mapped_file.h"
+#include "mesh_indexer.h"
+#include "mesh_normals.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "obj_parser.h"
+
+// distance from p to the triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+static float pointTriangleDistance(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+	glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+	float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) return glm::length(p - a);
+	glm::vec3 bp = p - b;
+	float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) return glm::length(p - b);
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+	glm::vec3 cp = p - c;
+	float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) return glm::length(p - c);
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+	float denominator = 1.0f / (va + vb + vc);
+	return glm::length(p - (a + ab * (vb * denominator) + ac * (vc * denominator)));
+}
+
+// measured one sided Hausdorff distance: how far the original vertices lie from the simplified surface
+static float measureError(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const MeshLod& lod) {
+	float worst = 0.0f;
+	for (const Vertex& v : vertices) {
+		float nearest = INFINITY;
+		for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.indexCount && nearest > worst; i += 3) {
+			nearest = std::min(nearest, pointTriangleDistance(v.Position, vertices[indices[i]].Position, vertices[indices[i + 1]].Position, vertices[indices[i + 2]].Position));
+		}
+		worst = std::max(worst, nearest);
+	}
+	return worst;
+}
+
+static bool report(const std::string& path) {
+	MappedFile obj;
+	if (!obj.open(path.c_str())) {
+		std::cout << "ERROR::MESH_REPORT::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+		return false;
+	}
+	ObjData data;
+	ObjParser::parse(obj.data(), obj.end(), data);
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	MeshIndexer::weld(data.vertices, vertices, indices);
+	MeshNormals::generateNormals(vertices, indices);
+
+	MeshBounds bounds = MeshBounds::compute(vertices.data(), vertices.size());
+	float diagonal = 2.0f * glm::length(bounds.box.halfExtent());
+
+	std::cout << path << ": " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles, bounds diagonal " << diagonal
+		<< ", bounding sphere radius " << bounds.sphere.radius << std::endl;
+	VertexCacheStats before = MeshOptimizer::analyze(indices.data(), indices.size(), vertices.size());
+
+	// the same steps as Mesh(const char*)
+	std::vector<MeshSubmesh> submeshes;
+	std::vector<MeshLod> lods = MeshSimplifier::buildMaterialLods(vertices, indices, ObjParser::triangleMaterials(data),
+		indices.size() / 3 >= 4096, submeshes);
+	std::vector<std::pair<uint32_t, uint32_t>> ranges;
+	for (const MeshSubmesh& submesh : submeshes) {
+		ranges.push_back(std::make_pair(submesh.firstIndex, submesh.indexCount));
+	}
+	MeshOptimizer::optimize(vertices, indices, ranges);
+
+	if (!data.materials.empty()) {
+		std::cout << "  " << data.materials.size() << " materials, " << submeshes.size() << " submeshes over " << lods.size() << " levels" << std::endl;
+	}
+	VertexCacheStats after = MeshOptimizer::analyze(indices.data(), lods[0].indexCount, vertices.size());
+	std::cout << "  vertex cache (FIFO " << MeshOptimizer::CACHE_SIZE << "): ACMR " << before.acmr << " -> " << after.acmr
+		<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+	bool ok = true;
+	for (size_t i = 1; i < lods.size(); i++) {
+		float measured = measureError(vertices, indices, lods[i]);
+		VertexCacheStats cache = MeshOptimizer::analyze(indices.data() + lods[i].firstIndex, lods[i].indexCount, vertices.size());
+		std::cout << "  LOD " << i << ": " << lods[i].indexCount / 3 << " triangles ("
+			<< 100.0f * lods[i].indexCount / lods[0].indexCount << "%), error bound " << lods[i].error
+			<< ", measured " << measured << " (" << 100.0f * measured / diagonal << "% of the diagonal), ACMR " << cache.acmr << std::endl;
+		if (lods[i].indexCount >= lods[i - 1].indexCount) {
+			std::cout << "ERROR::MESH_REPORT::NOT_REDUCED: LOD " << i << " of " << path << " has " << lods[i].indexCount / 3
+				<< " triangles, LOD " << i - 1 << " " << lods[i - 1].indexCount / 3 << std::endl;
+			ok = false;
+		}
+		if (measured > lods[i].error + 1e-5f * diagonal) {		// the tolerance covers float rounding in the distances
+			std::cout << "ERROR::MESH_REPORT::ERROR_ABOVE_BOUND: LOD " << i << " of " << path << " measured " << measured
+				<< ", bound " << lods[i].error << std::endl;
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> paths;
+	for (int i = 1; i < argc; i++) {
+		paths.push_back(argv[i]);
+	}
+	if (paths.empty()) {
+		const char* defaults[] = { "cube.obj", "meeple.obj", "pawn.obj", "sphere_smooth.obj" };
+		for (const char* name : defaults) {
+			paths.push_back(std::string(PATH_TO_OBJECTS "/") + name);
+		}
+	}
+
+	bool ok = true;
+	for (const std::string& path : paths) {
+		ok = report(path) && ok;
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+// Parse throughput of ObjParser against the previous std::getline / std::istringstream loader,
+// and of the chunked multi-threaded ObjParser against its single-threaded run. Exits with 1 when the outputs differ
+// or the number conversion does not round like strtof.
+// Usage: ObjParseBenchmark [file.obj] [iterations]   (defaults to objects/pawn.obj)
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "obj_parser.h"
+
+// the loader Object(const char*) used before ObjParser, kept as the reference
+static void legacyParse(const char* path, ObjData& out) {
+	std::ifstream infile(path);
+	std::string line;
+	while (std::getline(infile, line))
+	{
+		std::istringstream iss(line);
+		std::string indice;
+		iss >> indice;
+		if (indice == "v") {
+			float x, y, z;
+			iss >> x >> y >> z;
+			out.positions.push_back(glm::vec3(x, y, z));
+		}
+		else if (indice == "vn") {
+			float x, y, z;
+			iss >> x >> y >> z;
+			out.normals.push_back(glm::vec3(x, y, z));
+		}
+		else if (indice == "vt") {
+			float u, v;
+			iss >> u >> v;
+			out.textures.push_back(glm::vec2(u, v));
+		}
+		else if (indice == "f") {
+			std::string f[3];
+			iss >> f[0] >> f[1] >> f[2];
+			for (int i = 0; i < 3; i++) {
+				std::string p, t, n;
+				p = f[i].substr(0, f[i].find("/"));
+				f[i].erase(0, f[i].find("/") + 1);
+				t = f[i].substr(0, f[i].find("/"));
+				f[i].erase(0, f[i].find("/") + 1);
+				n = f[i].substr(0, f[i].find("/"));
+
+				Vertex v;
+				v.Position = out.positions.at(std::stof(p) - 1);
+				v.Normal = out.normals.at(std::stof(n) - 1);
+				v.Texture = out.textures.at(std::stof(t) - 1);
+				out.vertices.push_back(v);
+			}
+		}
+	}
+}
+
+static bool sameVertices(const ObjData& a, const ObjData& b) {
+	if (a.vertices.size() != b.vertices.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.vertices.size(); i++) {
+		const Vertex& u = a.vertices[i];
+		const Vertex& v = b.vertices[i];
+		if (u.Position != v.Position || u.Texture != v.Texture || u.Normal != v.Normal) {
+			std::cout << "first mismatch at vertex " << i << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// ObjParser::parseFloat against strtof, on numbers whose nearest double lies halfway between two floats (rounding
+// through double would be off by one ulp) and a few ordinary ones; and a file ending in a lone keyword
+static bool checkConversion() {
+	const char* numbers[] = {
+		"2.245491147041321", "3.997846879065037e-02", "-6.467168452218175e-03", "8.027060702443123e-02",
+		"1.000000059604644775390625", "0.1", "-0.70710678", "1e-45", "3.4028235e38", "123456789012345678901234567890"
+	};
+	bool ok = true;
+	for (const char* number : numbers) {
+		float parsed = 0.0f;
+		ObjParser::parseFloat(number, number + std::strlen(number), parsed);
+		float expected = std::strtof(number, nullptr);
+		if (std::memcmp(&parsed, &expected, sizeof(float)) != 0) {
+			std::cout << "parseFloat(" << number << ") differs from strtof" << std::endl;
+			ok = false;
+		}
+	}
+	// exactly sized, so a read past the last 'v' would leave the allocation
+	std::string text = "v 1 2 3\nvt 0.5 0.5\nv";
+	std::vector<char> file(text.begin(), text.end());
+	ObjData data;
+	ObjParser::parse(file.data(), file.data() + file.size(), data, 1);
+	if (data.positions.size() != 1 || data.textures.size() != 1) {
+		std::cout << "a trailing lone v is not skipped" << std::endl;
+		ok = false;
+	}
+	return ok;
+}
+
+template <typename Parse>
+static double bestSeconds(int iterations, Parse parse) {
+	double best = 1e30;
+	for (int i = 0; i < iterations; i++) {
+		auto start = std::chrono::steady_clock::now();
+		parse();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed.count() < best) {
+			best = elapsed.count();
+		}
+	}
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string path = argc > 1 ? argv[1] : PATH_TO_OBJECTS "/pawn.obj";
+	int iterations = argc > 2 ? std::atoi(argv[2]) : 5;
+
+	MappedFile file;
+	if (!file.open(path.c_str())) {
+		std::cout << "Cannot open " << path << std::endl;
+		return 1;
+	}
+	double megabytes = file.size() / (1024.0 * 1024.0);
+
+	bool converted = checkConversion();
+	unsigned threads = ThreadPool::shared().size() + 1;
+	ObjData reference, mapped, chunked;
+	legacyParse(path.c_str(), reference);
+	ObjParser::parse(file.data(), file.end(), mapped, 1);
+	ObjParser::parse(file.data(), file.end(), chunked, threads);
+	bool identical = sameVertices(reference, mapped);
+	bool chunkedIdentical = mapped.vertices.size() == chunked.vertices.size() &&
+		std::memcmp(mapped.vertices.data(), chunked.vertices.data(), mapped.vertices.size() * sizeof(Vertex)) == 0;
+
+	double legacy = bestSeconds(iterations, [&]() {
+		ObjData data;
+		legacyParse(path.c_str(), data);
+	});
+	double current = bestSeconds(iterations, [&]() {
+		ObjData data;
+		ObjParser::parse(file.data(), file.end(), data, 1);
+	});
+	double parallel = bestSeconds(iterations, [&]() {
+		ObjData data;
+		ObjParser::parse(file.data(), file.end(), data, threads);
+	});
+
+	std::cout << path << ": " << megabytes << " MB, " << mapped.vertices.size() << " vertices" << std::endl;
+	std::cout << "istringstream loader: " << legacy * 1000.0 << " ms (" << megabytes / legacy << " MB/s)" << std::endl;
+	std::cout << "ObjParser:            " << current * 1000.0 << " ms (" << megabytes / current << " MB/s)" << std::endl;
+	std::cout << "speedup: " << legacy / current << "x, output " << (identical ? "identical" : "DIFFERS") << std::endl;
+	std::cout << "ObjParser, " << threads << " chunks: " << parallel * 1000.0 << " ms (" << megabytes / parallel << " MB/s)" << std::endl;
+	std::cout << "speedup: " << current / parallel << "x, output " << (chunkedIdentical ? "identical" : "DIFFERS") << std::endl;
+	std::cout << "number conversion " << (converted ? "rounds like strtof" : "DIFFERS") << std::endl;
+	return identical && chunkedIdentical && converted ? 0 : 1;
+}
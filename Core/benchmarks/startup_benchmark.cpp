@@ -0,0 +1,119 @@
+// Cold and warm startup of the Core scene. Runs the Core executable headless (GLFW null platform with an OSMesa
+// context, needs libOSMesa at runtime) until every asset is loaded and reads the phases back from its Chrome trace.
+// Cold ignores and rebuilds the .vrmesh caches and program binaries, warm uses them. The OS file cache is warm in both cases.
+// Usage: StartupBenchmark [runs]   (defaults to 3 runs of each)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// milliseconds of one run: wall clock of the process, the marks of the trace and the busy time per category
+struct StartupRun {
+	double process = 0.0;
+	double firstFrame = 0.0;
+	double loaded = 0.0;
+	std::map<std::string, double> categories;
+};
+
+// value of "key": in one line of the trace Profiler::writeChromeTrace writes
+static std::string field(const std::string& line, const std::string& key) {
+	std::string pattern = "\"" + key + "\":";
+	size_t at = line.find(pattern);
+	if (at == std::string::npos) {
+		return std::string();
+	}
+	at += pattern.size();
+	if (line[at] == '"') {
+		size_t end = line.find('"', at + 1);
+		return line.substr(at + 1, end - at - 1);
+	}
+	size_t end = line.find_first_of(",}", at);
+	return line.substr(at, end - at);
+}
+
+static bool readTrace(const std::string& path, StartupRun& run) {
+	std::ifstream trace(path);
+	std::string line;
+	bool complete = false;
+	while (std::getline(trace, line)) {
+		std::string name = field(line, "name");
+		if (name.empty()) {
+			continue;
+		}
+		double start = std::atof(field(line, "ts").c_str()) / 1000.0;
+		double duration = std::atof(field(line, "dur").c_str()) / 1000.0;
+		if (name == "first frame") {
+			run.firstFrame = start + duration;
+		}
+		else if (name == "all assets loaded") {
+			run.loaded = start;
+			complete = true;
+		}
+		else if (name != "frame" && name != "load mesh") {		// load mesh only wraps read, parse, ...
+			run.categories[field(line, "cat")] += duration;
+		}
+	}
+	return complete;
+}
+
+static bool startup(bool cold, StartupRun& run) {
+	std::string trace = "startup_benchmark_trace.json";
+	std::remove(trace.c_str());
+	std::string command = std::string("\"") + CORE_EXECUTABLE + "\" --headless --exit-after-load --trace " + trace
+		+ (cold ? " --cold" : "") + " > startup_benchmark.log";
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int status = std::system(command.c_str());
+	run.process = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	if (status != 0 || !readTrace(trace, run)) {
+		std::cout << "Core did not start headless, see startup_benchmark.log (is libOSMesa installed?)" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static double median(std::vector<double> values) {
+	std::sort(values.begin(), values.end());
+	return values.empty() ? 0.0 : values[values.size() / 2];
+}
+
+int main(int argc, char* argv[])
+{
+	int runs = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 3;
+
+	const char* modes[] = { "cold", "warm" };
+	for (int mode = 0; mode < 2; mode++) {
+		std::vector<StartupRun> results;
+		for (int i = 0; i < runs; i++) {
+			StartupRun run;
+			if (!startup(mode == 0, run)) {
+				return 1;
+			}
+			results.push_back(run);
+		}
+
+		std::vector<double> process, firstFrame, loaded;
+		std::map<std::string, std::vector<double>> categories;
+		for (const StartupRun& run : results) {
+			process.push_back(run.process);
+			firstFrame.push_back(run.firstFrame);
+			loaded.push_back(run.loaded);
+			for (const std::pair<const std::string, double>& category : run.categories) {
+				categories[category.first].push_back(category.second);
+			}
+		}
+		std::cout << modes[mode] << " startup, median of " << runs << " runs:" << std::endl;
+		std::cout << "  first frame       " << median(firstFrame) << " ms" << std::endl;
+		std::cout << "  all assets loaded " << median(loaded) << " ms" << std::endl;
+		std::cout << "  whole process     " << median(process) << " ms" << std::endl;
+		for (const std::pair<const std::string, std::vector<double>>& category : categories) {
+			std::cout << "  " << category.first << " busy " << median(category.second) << " ms" << std::endl;
+		}
+	}
+	return 0;
+}
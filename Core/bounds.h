@@ -0,0 +1,124 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define BOUNDS_SSE 1
+#endif
+
+#include "vertex.h"
+
+// Axis aligned box, min > max when empty
+struct BoundingBox {
+	glm::vec3 min = glm::vec3(1.0f);
+	glm::vec3 max = glm::vec3(-1.0f);
+
+	bool empty() const {
+		return min.x > max.x;
+	}
+
+	glm::vec3 center() const {
+		return 0.5f * (min + max);
+	}
+
+	glm::vec3 halfExtent() const {
+		return empty() ? glm::vec3(0.0f) : 0.5f * (max - min);
+	}
+
+	// min/max over the positions, four lanes at a time with SSE
+	static BoundingBox around(const Vertex* vertices, size_t count) {
+		BoundingBox box;
+		if (count == 0) {
+			return box;
+		}
+#ifdef BOUNDS_SSE
+		// Position is followed by Texture inside Vertex, so the fourth lane reads a uv and is ignored
+		static_assert(offsetof(Vertex, Texture) == offsetof(Vertex, Position) + 3 * sizeof(float), "a 4 float load of Position must stay inside Vertex");
+		__m128 lower = _mm_loadu_ps(&vertices[0].Position.x);
+		__m128 upper = lower;
+		for (size_t i = 1; i < count; i++) {
+			__m128 p = _mm_loadu_ps(&vertices[i].Position.x);
+			lower = _mm_min_ps(lower, p);
+			upper = _mm_max_ps(upper, p);
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, lower);
+		box.min = glm::vec3(lanes[0], lanes[1], lanes[2]);
+		_mm_storeu_ps(lanes, upper);
+		box.max = glm::vec3(lanes[0], lanes[1], lanes[2]);
+#else
+		box.min = box.max = vertices[0].Position;
+		for (size_t i = 1; i < count; i++) {
+			box.min = glm::min(box.min, vertices[i].Position);
+			box.max = glm::max(box.max, vertices[i].Position);
+		}
+#endif
+		return box;
+	}
+
+	// the box around the transformed box (Arvo, Graphics Gems 1990): every output axis takes the smaller and the larger
+	// of each matrix entry times the input extent
+	BoundingBox transformed(const glm::mat4& m) const {
+		if (empty()) {
+			return *this;
+		}
+		BoundingBox box;
+		box.min = box.max = glm::vec3(m[3]);
+		for (int column = 0; column < 3; column++) {
+			for (int row = 0; row < 3; row++) {
+				float a = m[column][row] * min[column];
+				float b = m[column][row] * max[column];
+				box.min[row] += glm::min(a, b);
+				box.max[row] += glm::max(a, b);
+			}
+		}
+		return box;
+	}
+};
+
+// Sphere around the same points, radius < 0 when empty
+struct BoundingSphere {
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = -1.0f;
+
+	// scaled by the largest scale factor of m, so it still contains the points under non uniform scale
+	BoundingSphere transformed(const glm::mat4& m) const {
+		if (radius < 0.0f) {
+			return *this;
+		}
+		float scale = glm::max(glm::length(glm::vec3(m[0])), glm::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+		BoundingSphere sphere;
+		sphere.center = glm::vec3(m * glm::vec4(center, 1.0f));
+		sphere.radius = radius * scale;
+		return sphere;
+	}
+};
+
+// Bounding volumes of a mesh in object space, computed once at load and kept in the .vrmesh header
+struct MeshBounds {
+	BoundingBox box;
+	BoundingSphere sphere;
+
+	// The sphere is centered in the box with the farthest vertex on its surface: not minimal, but its radius is at most
+	// half the box diagonal
+	static MeshBounds compute(const Vertex* vertices, size_t count) {
+		MeshBounds bounds;
+		if (count == 0) {
+			return bounds;
+		}
+		bounds.box = BoundingBox::around(vertices, count);
+		bounds.sphere.center = bounds.box.center();
+		float radiusSquared = 0.0f;
+		for (size_t i = 0; i < count; i++) {
+			glm::vec3 d = vertices[i].Position - bounds.sphere.center;
+			radiusSquared = glm::max(radiusSquared, glm::dot(d, d));
+		}
+		bounds.sphere.radius = glm::sqrt(radiusSquared);
+		return bounds;
+	}
+};
+#endif
@@ -0,0 +1,124 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <cstring>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+// What every program gets once per frame, laid out like the std140 block Frame in the shaders:
+//
+//     layout(std140) uniform Frame {
+//         mat4 V;
+//         mat4 P;
+//         mat4 VP;
+//         vec3 u_view_pos;
+//         float time;
+//     };
+struct FrameData {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec3 viewPosition;		// the float after it fills the padding std140 puts behind a vec3
+	float time;
+};
+
+static_assert(sizeof(FrameData) == 208, "FrameData has to match the std140 layout of the Frame block");
+
+// The uniform buffer behind the Frame block, written once per frame and bound to FRAME_BLOCK_BINDING, where Shader
+// puts the block of every program. It holds a few frames: the GPU may still draw the previous frames while the next
+// one is written, a fence per slot tells when it is free again. With GL_ARB_buffer_storage the slots are written
+// through a persistent mapping, otherwise with glBufferSubData
+class FrameUniforms
+{
+public:
+	static const int FRAMES = 3;
+
+	FrameUniforms() {}
+
+	FrameUniforms(const FrameUniforms&) = delete;
+	FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+	~FrameUniforms() {
+		destroy();
+	}
+
+	void create() {
+		if (buffer != 0) {
+			return;
+		}
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		stride = (sizeof(FrameData) + alignment - 1) / alignment * alignment;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		if (GLAD_GL_ARB_buffer_storage) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_UNIFORM_BUFFER, stride * FRAMES, nullptr, flags);
+			mapped = static_cast<char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, stride * FRAMES, flags));
+		}
+		else {
+			glBufferData(GL_UNIFORM_BUFFER, stride * FRAMES, nullptr, GL_DYNAMIC_DRAW);
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		fences.assign(FRAMES, nullptr);
+	}
+
+	void destroy() {
+		if (buffer == 0 || glfwGetCurrentContext() == nullptr) {
+			return;
+		}
+		for (GLsync fence : fences) {
+			if (fence != nullptr) {
+				glDeleteSync(fence);
+			}
+		}
+		fences.clear();
+		if (mapped != nullptr) {
+			glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+		mapped = nullptr;
+	}
+
+	// Once per frame before the first draw: fences the previous frame, writes data into the next slot and binds it
+	void update(const FrameData& data) {
+		if (buffer == 0) {
+			return;
+		}
+		if (frame >= 0) {
+			fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+		frame = (frame + 1) % FRAMES;
+		if (fences[frame] != nullptr) {
+			// only blocks when the GPU is FRAMES frames behind
+			glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+			glDeleteSync(fences[frame]);
+			fences[frame] = nullptr;
+		}
+		size_t offset = size_t(frame) * stride;
+		if (mapped != nullptr) {
+			std::memcpy(mapped + offset, &data, sizeof(FrameData));
+		}
+		else {
+			glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(FrameData), &data);
+		}
+		glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, buffer, offset, sizeof(FrameData));
+	}
+
+private:
+	GLuint buffer = 0;
+	char* mapped = nullptr;
+	size_t stride = 0;
+	int frame = -1;		// the slot written last
+	std::vector<GLsync> fences;		// per slot, set when the next frame starts
+};
+#endif
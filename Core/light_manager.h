@@ -0,0 +1,138 @@
+#ifndef LIGHT_MANAGER_H
+#define LIGHT_MANAGER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+// A point light as the shaders read it, laid out like one element of the std140 array in the Lights block:
+//
+//     struct Light {
+//         vec3 light_pos;
+//         float ambient_strength;
+//         float diffuse_strength;
+//         float specular_strength;
+//         float constant;
+//         float linear;
+//         float quadratic;
+//         int mask;
+//     };
+//     layout(std140) uniform Lights {
+//         int light_count;
+//         Light lights[MAX_LIGHTS];
+//     };
+//
+// A program is lit by the lights whose mask shares a bit with its light_mask uniform
+struct Light {
+	glm::vec3 position = glm::vec3(0.0f);
+	float ambient = 0.0f;
+	float diffuse = 0.0f;
+	float specular = 0.0f;
+	float constant = 1.0f;		// attenuation factors
+	float linear = 0.14f;
+	float quadratic = 0.07f;
+	int32_t mask = 0;
+	float padding[2] = { 0.0f, 0.0f };		// std140 rounds the struct up to 16 bytes
+};
+
+static_assert(sizeof(Light) == 48, "Light has to match the std140 layout of the Lights block");
+
+// All lights of the scene in one uniform buffer, bound to LIGHTS_BLOCK_BINDING where Shader puts the Lights block of
+// every program. Lights can be added and changed at any time; update uploads the bytes that changed since the last
+// call, so a scene whose lights stay put costs nothing per frame
+class LightManager
+{
+public:
+	static const size_t MAX_LIGHTS = 256;		// the array size in the shaders, 12 KiB, within the 16 KiB every GL has
+	static const size_t NONE = size_t(-1);
+
+	LightManager() {}
+
+	LightManager(const LightManager&) = delete;
+	LightManager& operator=(const LightManager&) = delete;
+
+	~LightManager() {
+		if (buffer != 0 && glfwGetCurrentContext() != nullptr) {
+			glDeleteBuffers(1, &buffer);
+		}
+	}
+
+	void create() {
+		if (buffer != 0) {
+			return;
+		}
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		glBufferData(GL_UNIFORM_BUFFER, ARRAY_OFFSET + MAX_LIGHTS * sizeof(Light), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, LIGHTS_BLOCK_BINDING, buffer);
+		countDirty = true;
+	}
+
+	// index of the new light, NONE if the buffer is full
+	size_t add(const Light& light) {
+		if (lights.size() == MAX_LIGHTS) {
+			std::cout << "WARNING::LIGHT_MANAGER::FULL: " << MAX_LIGHTS << " lights" << std::endl;
+			return NONE;
+		}
+		lights.push_back(light);
+		markDirty(lights.size() - 1);
+		countDirty = true;
+		return lights.size() - 1;
+	}
+
+	void set(size_t i, const Light& light) {
+		lights[i] = light;
+		markDirty(i);
+	}
+
+	const Light& get(size_t i) const {
+		return lights[i];
+	}
+
+	size_t size() const {
+		return lights.size();
+	}
+
+	// Once per frame before drawing: uploads the lights changed since the last call, as one range
+	void update() {
+		if (buffer == 0 || (!countDirty && dirtyBegin >= dirtyEnd)) {
+			return;
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+		if (countDirty) {
+			int32_t count[4] = { int32_t(lights.size()), 0, 0, 0 };
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(count), count);
+			countDirty = false;
+		}
+		if (dirtyBegin < dirtyEnd) {
+			glBufferSubData(GL_UNIFORM_BUFFER, ARRAY_OFFSET + dirtyBegin * sizeof(Light), (dirtyEnd - dirtyBegin) * sizeof(Light), &lights[dirtyBegin]);
+			dirtyBegin = MAX_LIGHTS;
+			dirtyEnd = 0;
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+private:
+	static const size_t ARRAY_OFFSET = 16;		// light_count, padded to the alignment of the array
+
+	GLuint buffer = 0;
+	std::vector<Light> lights;
+	size_t dirtyBegin = MAX_LIGHTS;		// the lights [dirtyBegin, dirtyEnd) changed
+	size_t dirtyEnd = 0;
+	bool countDirty = false;
+
+	void markDirty(size_t i) {
+		dirtyBegin = std::min(dirtyBegin, i);
+		dirtyEnd = std::max(dirtyEnd, i + 1);
+	}
+};
+#endif
@@ -0,0 +1,166 @@
+#ifndef LZ4_BLOCK_H
+#define LZ4_BLOCK_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Compressor and decompressor for the LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md).
+// Greedy matching over a small hash table: much simpler than the reference compressor and a little worse in ratio,
+// but the output is plain LZ4 and decompresses at memory speed. Used for the blocks of an AssetPack
+class Lz4Block
+{
+public:
+	// largest output compress can produce for size input bytes
+	static size_t bound(size_t size) {
+		return size + size / 255 + 16;
+	}
+
+	// Appends the compressed form of [src, src + size) to out and returns its length
+	static size_t compress(const char* src, size_t size, std::vector<char>& out) {
+		size_t start = out.size();
+		out.resize(start + bound(size));
+		unsigned char* op = reinterpret_cast<unsigned char*>(out.data() + start);
+		const unsigned char* base = reinterpret_cast<const unsigned char*>(src);
+		const unsigned char* ip = base;
+		const unsigned char* anchor = base;
+		const unsigned char* end = base + size;
+
+		// the format wants the last match to start 12 bytes and to end 5 bytes before the end of the block
+		if (size > MIN_INPUT) {
+			const unsigned char* matchStartLimit = end - 12;
+			const unsigned char* matchEndLimit = end - 5;
+			std::vector<uint32_t> table(HASH_SIZE, 0xffffffffu);
+			while (ip <= matchStartLimit) {
+				uint32_t sequence = read32(ip);
+				uint32_t& slot = table[(sequence * 2654435761u) >> (32 - HASH_BITS)];
+				const unsigned char* candidate = slot == 0xffffffffu ? nullptr : base + slot;
+				slot = static_cast<uint32_t>(ip - base);
+				if (candidate == nullptr || ip - candidate > MAX_OFFSET || read32(candidate) != sequence) {
+					ip++;
+					continue;
+				}
+				const unsigned char* matchEnd = ip + 4;
+				const unsigned char* reference = candidate + 4;
+				while (matchEnd < matchEndLimit && *matchEnd == *reference) {
+					matchEnd++;
+					reference++;
+				}
+				op = writeSequence(op, anchor, ip - anchor, static_cast<uint32_t>(ip - candidate), matchEnd - ip);
+				ip = matchEnd;
+				anchor = ip;
+			}
+		}
+		op = writeSequence(op, anchor, end - anchor, 0, 0);
+
+		size_t length = op - reinterpret_cast<unsigned char*>(out.data() + start);
+		out.resize(start + length);
+		return length;
+	}
+
+	// Decompresses exactly dstSize bytes. Returns false for malformed input instead of reading or writing out of bounds
+	static bool decompress(const char* src, size_t srcSize, char* dst, size_t dstSize) {
+		const unsigned char* ip = reinterpret_cast<const unsigned char*>(src);
+		const unsigned char* inputEnd = ip + srcSize;
+		unsigned char* op = reinterpret_cast<unsigned char*>(dst);
+		unsigned char* outputEnd = op + dstSize;
+
+		while (ip < inputEnd) {
+			unsigned token = *ip++;
+			size_t literals = token >> 4;
+			if (literals == 15 && !readLength(ip, inputEnd, literals)) {
+				return false;
+			}
+			if (literals > size_t(inputEnd - ip) || literals > size_t(outputEnd - op)) {
+				return false;
+			}
+			std::memcpy(op, ip, literals);
+			op += literals;
+			ip += literals;
+			if (ip == inputEnd) {
+				break;		// the last sequence has no match
+			}
+
+			if (inputEnd - ip < 2) {
+				return false;
+			}
+			size_t offset = ip[0] | (size_t(ip[1]) << 8);
+			ip += 2;
+			size_t length = token & 15;
+			if (length == 15 && !readLength(ip, inputEnd, length)) {
+				return false;
+			}
+			length += 4;
+			if (offset == 0 || offset > size_t(op - reinterpret_cast<unsigned char*>(dst)) || length > size_t(outputEnd - op)) {
+				return false;
+			}
+			const unsigned char* match = op - offset;
+			if (offset >= length) {
+				std::memcpy(op, match, length);
+				op += length;
+			}
+			else {
+				for (size_t i = 0; i < length; i++) {		// overlapping, repeats the last offset bytes
+					*op++ = *match++;
+				}
+			}
+		}
+		return op == outputEnd;
+	}
+
+private:
+	static const int HASH_BITS = 12;
+	static const size_t HASH_SIZE = size_t(1) << HASH_BITS;
+	static const ptrdiff_t MAX_OFFSET = 65535;
+	static const size_t MIN_INPUT = 12;		// shorter blocks are stored as literals only
+
+	static uint32_t read32(const unsigned char* p) {
+		uint32_t value;
+		std::memcpy(&value, p, 4);
+		return value;
+	}
+
+	// the 255 continuation bytes of a length that does not fit its 4 bit field
+	static bool readLength(const unsigned char*& ip, const unsigned char* end, size_t& length) {
+		unsigned char byte;
+		do {
+			if (ip >= end) {
+				return false;
+			}
+			byte = *ip++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	static unsigned char* writeLength(unsigned char* op, size_t length) {
+		for (length -= 15; length >= 255; length -= 255) {
+			*op++ = 255;
+		}
+		*op++ = static_cast<unsigned char>(length);
+		return op;
+	}
+
+	// literals followed by a match, matchLength 0 for the last sequence of the block
+	static unsigned char* writeSequence(unsigned char* op, const unsigned char* literals, size_t literalLength, uint32_t offset, size_t matchLength) {
+		unsigned char* token = op++;
+		*token = static_cast<unsigned char>((literalLength < 15 ? literalLength : 15) << 4);
+		if (literalLength >= 15) {
+			op = writeLength(op, literalLength);
+		}
+		std::memcpy(op, literals, literalLength);
+		op += literalLength;
+		if (matchLength == 0) {
+			return op;
+		}
+		*op++ = static_cast<unsigned char>(offset);
+		*op++ = static_cast<unsigned char>(offset >> 8);
+		size_t code = matchLength - 4;
+		*token |= static_cast<unsigned char>(code < 15 ? code : 15);
+		if (code >= 15) {
+			op = writeLength(op, code);
+		}
+		return op;
+	}
+};
+#endif
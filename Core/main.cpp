@@ -7,10 +7,23 @@
 #include<glm/gtc/matrix_inverse.hpp>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#undef STB_IMAGE_IMPLEMENTATION		// the headers include stb_image.h again for the declarations only
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "stb_image_resize.h"
+#undef STB_IMAGE_RESIZE_IMPLEMENTATION
 #include <map>
 #include "camera.h"
 #include "shader.h"
+#include "frame_uniforms.h"
+#include "light_manager.h"
+#include "shader_reloader.h"
 #include "object.h"
+#include "mesh_registry.h"
+#include "skybox_manager.h"
+#include "texture_cache.h"
+#include "asset_loader.h"
+#include "asset_pack.h"
+#include "profiler.h"
 
 // ######## Session Variables ############
 const int window_width = 800;
@@ -41,7 +54,6 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 GLuint compileShader(std::string shaderCode, GLenum shaderType);
 GLuint compileProgram(GLuint vertexShader, GLuint fragmentShader);
 void processKeyboardCameraInput(GLFWwindow* window);
-void loadCubemapFace(const char* path, const GLenum& targetFace);
 
 
 #ifndef NDEBUG
@@ -93,36 +105,11 @@ void APIENTRY glDebugOutput(GLenum source,
 }
 #endif
 
-GLuint loadTexture(const char* path) {
-	stbi_set_flip_vertically_on_load(true);
-	int width, height, nrChannels;
-	unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
-	if (!data) {
-		std::cout << "Failed to load texture" << std::endl;
-		return 0;
-	}
-
-	GLuint texture;
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	stbi_image_free(data);
-
-	return texture;
-}
-
 // some global variables
 bool nKeyPressed = false;
 bool fKeyPressed = false;
 bool enterKeyPressed = false;
+bool cKeyPressed = false;
 
 std::string current_Team = "bright";
 bool endGame = false;
@@ -529,14 +516,80 @@ int main(int argc, char* argv[])
 {
 	std::cout << "Welcome to the demo by Igors and Veronika" << std::endl;
 
+	// command line options, used by StartupBenchmark:
+	// --headless         GLFW null platform with an OSMesa context, nothing is shown
+	// --trace file.json  Chrome trace of the startup, written once every asset is loaded
+	// --exit-after-load  close after the first frame that has every asset
+	// --cold             ignore the .vrmesh caches and the program binaries and build them again
+	// --pack file        read the assets from this pack (AssetPacker), by default assets.vrpack next to the executable
+	//                    is used when it exists. Assets missing from the pack are read from their directories
+	// --loose            read assets edited since the pack was built from their directories, not from the pack
+	bool headless = false;
+	bool exitAfterLoad = false;
+	std::string tracePath;
+	std::string packPath;
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		if (option == "--headless") {
+			headless = true;
+		}
+		else if (option == "--trace" && i + 1 < argc) {
+			tracePath = argv[++i];
+		}
+		else if (option == "--exit-after-load") {
+			exitAfterLoad = true;
+		}
+		else if (option == "--cold") {
+			MeshCache::forceRebuild() = true;
+			ProgramCache::forceRebuild() = true;
+		}
+		else if (option == "--pack" && i + 1 < argc) {
+			packPath = argv[++i];
+		}
+		else if (option == "--loose") {
+			AssetFile::preferEdited() = true;
+		}
+		else {
+			std::cout << "WARNING::MAIN::UNKNOWN_OPTION: " << option << std::endl;
+		}
+	}
+	Profiler& profiler = Profiler::instance();		// the trace starts here
+	int64_t contextStart = profiler.now();
+
+	// the pack and the linked programs are kept next to the executable
+	std::string executable = argv[0];
+	size_t slash = executable.find_last_of("/\\");
+	std::string executableDirectory = slash == std::string::npos ? std::string() : executable.substr(0, slash + 1);
+	ProgramCache::shared().setDirectory(executableDirectory + "shader_cache");
+	{
+		ProfileScope mounting("mount asset pack", "io", packPath);
+		bool explicitPack = !packPath.empty();
+		if (!explicitPack) {
+			packPath = executableDirectory + "assets.vrpack";
+		}
+		if (AssetPack::shared().mount(packPath, PATH_TO_ASSETS)) {
+			std::cout << "Assets from " << packPath << " (" << AssetPack::shared().size() << " files)" << std::endl;
+		}
+		else if (explicitPack) {
+			std::cout << "ERROR::MAIN::ASSET_PACK_NOT_LOADED: " << packPath << std::endl;
+		}
+	}
+
 	//Boilerplate
 	//Create the OpenGL context
+	if (headless) {
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	}
 	if (!glfwInit()) {
 		throw std::runtime_error("Failed to initialise GLFW \n");
 	}
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if (headless) {
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
 
 #ifndef NDEBUG
 	//create a debug context to help with Debugging
@@ -562,6 +615,8 @@ int main(int argc, char* argv[])
 	}
 
 	glEnable(GL_DEPTH_TEST);
+	profiler.record("create context", "gl", "", contextStart, profiler.now() - contextStart);
+	int64_t setupStart = profiler.now();
 
 #ifndef NDEBUG
 	int flags;
@@ -600,6 +655,12 @@ int main(int argc, char* argv[])
     Shader Globe_Shader = Shader(Globe_Vertex_Shader_file, Globe_Fragment_Shader_file);
 // ###########################################
 
+    // edits to the shader files show up in the running scene
+    ShaderReloader shaderReloader(PATH_TO_SHADERS);
+    for (const Shader& shader : { Checkers_Shader, cubeMapShader, Room_Shader, Globe_Shader }) {
+        shaderReloader.watch(shader);
+    }
+
 
 // ######## FPS Counter #######################
 	double prev = 0;
@@ -617,78 +678,89 @@ int main(int argc, char* argv[])
 		};
 // ###########################################
 
+    // every .obj is loaded once, the 64 fields and the 24 meeples share one mesh each
+    MeshRegistry meshes;
+
+    // and every image once per format, a texture is freed when nothing refers to it anymore
+    TextureCache textures;
+
+    // meshes and images load in the background, the render loop uploads them as they arrive
+    AssetLoader assets;
+
 // Chess Board Chopped
 
     //texture
 
 
-	std::vector<std::vector<Object>> board;		// 2Dvector for all fields
+	// the field colors and the meeple textures are the layers of one texture array, so the board and all pieces
+	// draw with a single binding and only their layer changes between draws
+	enum PieceLayer { WHITE_FIELD_LAYER, BLACK_FIELD_LAYER, DARK_MEEPLE_LAYER, BRIGHT_MEEPLE_LAYER };
 	char path_Board_Colour_1[] = PATH_TO_TEXTURE"/Checkers_Board/Board_Colour_1.png";
-	GLuint Board_Texture_1 = loadTexture(path_Board_Colour_1);
-
 	char path_Board_Colour_2[] = PATH_TO_TEXTURE"/Checkers_Board/Board_Colour_2.png";
-	GLuint Board_Texture_2 = loadTexture(path_Board_Colour_2);
+	char Darkmeeple_texturePath[] = PATH_TO_TEXTURE"/meeples/Darkmeeple.jpg";
+	char Brightmeeple_texturePath[] = PATH_TO_TEXTURE"/meeples/Brightmeeple.jpg";
+	std::shared_ptr<Texture> pieceTextures = assets.loadTextureArray({ path_Board_Colour_1, path_Board_Colour_2, Darkmeeple_texturePath, Brightmeeple_texturePath }, 512, 512);
+
+	std::vector<std::vector<Object>> board;		// 2Dvector for all fields
 
 	char pathBoard[] = PATH_TO_OBJECTS"/Chess_Board_Chopped/Board_0x_0y.obj";
+	std::shared_ptr<Mesh> fieldMesh = assets.loadMesh(meshes, pathBoard, Checkers_Shader, true, VertexFormat::Snorm16);		// 16 byte vertices, draw with getRenderModel()
 	for (int i = 0; i < 8; i++) {
 		std::vector<Object> row;
 		for (int j = 0; j < 8; j++) {
-			Object field(pathBoard);
+			Object field(fieldMesh);
 			field.position = glm::vec3(2.0 * j, 0.0, 2.0 * i);
 			field.model = glm::translate(field.model, field.position);
-			field.makeObject(Checkers_Shader);
 			if ((i + j) % 2 == 0) {
 				field.color = "white";
+				field.textureLayer = WHITE_FIELD_LAYER;
+			}
+			else {
+				field.color = "black";
+				field.textureLayer = BLACK_FIELD_LAYER;
 			}
-			else { field.color = "black"; }
 			row.push_back(field);
 		}
 		board.push_back(row);
 	}
 
     // load and arrange meeples
-    char Darkmeeple_texturePath[] = PATH_TO_TEXTURE"/meeples/Darkmeeple.jpg";
-    GLuint Darkmeeple_texture = loadTexture(Darkmeeple_texturePath);
     char path_meeple[] = PATH_TO_OBJECTS"/meeple.obj";
+    std::shared_ptr<Mesh> meepleMesh = assets.loadMesh(meshes, path_meeple, Checkers_Shader, true, VertexFormat::Snorm16);
     std::vector<Object> Darkmeeples;
     for (int i = 0; i < 12; i++) {
-        Object Darkmeeple(path_meeple);
+        Object Darkmeeple(meepleMesh);
         Darkmeeple.color = "dark";
+        Darkmeeple.textureLayer = DARK_MEEPLE_LAYER;
         //Darkmeeple.model = glm::translate(Darkmeeple.model, glm::vec3(2.0*i, 2.0, 2.0));
-        Darkmeeple.makeObject(Checkers_Shader);
         Darkmeeples.push_back(Darkmeeple);
     }
     std::vector<Object> Brightmeeples;
-    char Brightmeeple_texturePath[] = PATH_TO_TEXTURE"/meeples/Brightmeeple.jpg";
-    GLuint Brightmeeple_texture = loadTexture(Brightmeeple_texturePath);
     for (int i = 0; i < 12; i++) {
-        Object Brightmeeple(path_meeple);
+        Object Brightmeeple(meepleMesh);
         Brightmeeple.color = "bright";
+        Brightmeeple.textureLayer = BRIGHT_MEEPLE_LAYER;
         //Brightmeeple.model = glm::translate(Brightmeeple.model, glm::vec3(2.0 * i, 2.0, 2.0));
-        Brightmeeple.makeObject(Checkers_Shader);
         Brightmeeples.push_back(Brightmeeple);
     }
 
     char pathRoom[] = PATH_TO_OBJECTS"/room/room_fixed.obj";
-    Object room(pathRoom);
-    room.makeObject(Room_Shader, false);
+    Object room(assets.loadMesh(meshes, pathRoom, Room_Shader, false, VertexFormat::Float32, &textures));
     room.model = glm::scale(room.model, glm::vec3(0.99, 0.99, 0.99));
     room.position = glm::vec3(7.0, -5.0, 10.0);
     room.model = glm::translate(room.model, room.position);
 
     char path_glass_texture[] = PATH_TO_TEXTURE"/glass.jpeg";
-    GLuint glass_texture = loadTexture(path_glass_texture);
+    std::shared_ptr<Texture> glass_texture = assets.loadTexture(textures, path_glass_texture);
     char pathGlobe[] = PATH_TO_OBJECTS"/room/globe_relocated.obj";
-    Object globe(pathGlobe);
-    globe.makeObject(Globe_Shader);
+    Object globe(assets.loadMesh(meshes, pathGlobe, Globe_Shader, true, VertexFormat::Float32, &textures));
     globe.model = glm::scale(globe.model, glm::vec3(0.99, 0.99, 0.99));
     globe.position = glm::vec3(13.0, 15.0, -78.0);
     globe.model = glm::translate(globe.model, globe.position);
 
 
     char pathCube[] = PATH_TO_OBJECTS "/cube.obj";
-    Object cubeMap(pathCube);
-    cubeMap.makeObject(cubeMapShader);
+    Object cubeMap(assets.loadMesh(meshes, pathCube, cubeMapShader));
 
 
     //Rendering
@@ -711,140 +783,65 @@ int main(int argc, char* argv[])
 
     glm::vec3 materialColour = glm::vec3(0.5f, 0.5f, 0.5f);
 
+    // every light of the scene is in one uniform buffer, each program picks the ones of its light_mask
+    enum LightGroup { ROOM_LIGHTS = 1, BOARD_LIGHTS = 2, GLOBE_LIGHTS = 4 };
+    LightManager lightManager;
+    lightManager.create();
+
+    Light roomLight;
+    roomLight.ambient = room_ambient;
+    roomLight.diffuse = room_diffuse;
+    roomLight.specular = room_specular;
+    roomLight.mask = ROOM_LIGHTS;
+    for (const glm::vec3& position : lightPositions) {
+        roomLight.position = position;
+        lightManager.add(roomLight);
+    }
+
     Room_Shader.use();
     Room_Shader.setFloat("shininess", 0.92f);
     Room_Shader.setVector3f("materialColour", materialColour);
-
-    Room_Shader.setVector3f("lights[0].light_pos", lightPositions[0]);
-    Room_Shader.setFloat("lights[0].ambient_strength", room_ambient);
-    Room_Shader.setFloat("lights[0].diffuse_strength", room_diffuse);
-    Room_Shader.setFloat("lights[0].diffuse_strength", room_specular);
-    Room_Shader.setFloat("lights[0].constant", 1.0);
-    Room_Shader.setFloat("lights[0].linear", 0.14);
-    Room_Shader.setFloat("lights[0].quadratic", 0.07);
-
-    Room_Shader.setVector3f("lights[1].light_pos", lightPositions[1]);
-    Room_Shader.setFloat("lights[1].ambient_strength", room_ambient);
-    Room_Shader.setFloat("lights[1].diffuse_strength", room_diffuse);
-    Room_Shader.setFloat("lights[1].specular_strength", room_specular);
-    Room_Shader.setFloat("lights[1].constant", 1.0);
-    Room_Shader.setFloat("lights[1].linear", 0.14);
-    Room_Shader.setFloat("lights[1].quadratic", 0.07);
-
-    Room_Shader.setVector3f("lights[2].light_pos", lightPositions[2]);
-    Room_Shader.setFloat("lights[2].ambient_strength", room_ambient);
-    Room_Shader.setFloat("lights[2].diffuse_strength", room_diffuse);
-    Room_Shader.setFloat("lights[2].specular_strength", room_specular);
-    Room_Shader.setFloat("lights[2].constant", 1.0);
-    Room_Shader.setFloat("lights[2].linear", 0.14);
-    Room_Shader.setFloat("lights[2].quadratic", 0.07);
-
-    Room_Shader.setVector3f("lights[3].light_pos", lightPositions[3]);
-    Room_Shader.setFloat("lights[3].ambient_strength", room_ambient);
-    Room_Shader.setFloat("lights[3].diffuse_strength", room_diffuse);
-    Room_Shader.setFloat("lights[3].specular_strength", room_specular);
-    Room_Shader.setFloat("lights[3].constant", 1.0);
-    Room_Shader.setFloat("lights[3].linear", 0.14);
-    Room_Shader.setFloat("lights[3].quadratic", 0.07);
-
-    Room_Shader.setVector3f("lights[4].light_pos", lightPositions[4]);
-    Room_Shader.setFloat("lights[4].ambient_strength", room_ambient);
-    Room_Shader.setFloat("lights[4].diffuse_strength", room_diffuse);
-    Room_Shader.setFloat("lights[4].specular_strength", room_specular);
-    Room_Shader.setFloat("lights[4].constant", 1.0);
-    Room_Shader.setFloat("lights[4].linear", 0.14);
-    Room_Shader.setFloat("lights[4].quadratic", 0.07);
-
-    Room_Shader.setVector3f("lights[5].light_pos", lightPositions[5]);
-    Room_Shader.setFloat("lights[5].ambient_strength", room_ambient);
-    Room_Shader.setFloat("lights[5].diffuse_strength", room_diffuse);
-    Room_Shader.setFloat("lights[5].specular_strength", room_specular);
-    Room_Shader.setFloat("lights[5].constant", 1.0);
-    Room_Shader.setFloat("lights[5].linear", 0.14);
-    Room_Shader.setFloat("lights[5].quadratic", 0.07);
-
-    Room_Shader.setVector3f("lights[6].light_pos", lightPositions[6]);
-    Room_Shader.setFloat("lights[6].ambient_strength", room_ambient);
-    Room_Shader.setFloat("lights[6].diffuse_strength", room_diffuse);
-    Room_Shader.setFloat("lights[6].specular_strength", room_specular);
-    Room_Shader.setFloat("lights[6].constant", 1.0);
-    Room_Shader.setFloat("lights[6].linear", 0.14);
-    Room_Shader.setFloat("lights[6].quadratic", 0.07);
-
-    Room_Shader.setVector3f("lights[7].light_pos", lightPositions[7]);
-    Room_Shader.setFloat("lights[7].ambient_strength", room_ambient);
-    Room_Shader.setFloat("lights[7].diffuse_strength", room_diffuse);
-    Room_Shader.setFloat("lights[7].specular_strength", room_specular);
-    Room_Shader.setFloat("lights[7].constant", 1.0);
-    Room_Shader.setFloat("lights[7].linear", 0.14);
-    Room_Shader.setFloat("lights[7].quadratic", 0.07);
-
-    Room_Shader.setVector3f("lights[8].light_pos", lightPositions[8]);
-    Room_Shader.setFloat("lights[8].ambient_strength", room_ambient);
-    Room_Shader.setFloat("lights[8].diffuse_strength", room_diffuse);
-    Room_Shader.setFloat("lights[8].specular_strength", room_specular);
-    Room_Shader.setFloat("lights[8].constant", 1.0);
-    Room_Shader.setFloat("lights[8].linear", 0.14);
-    Room_Shader.setFloat("lights[8].quadratic", 0.07);
-    
+    Room_Shader.setInteger("light_mask", ROOM_LIGHTS);
 
     // Board light:
     glm::vec3 light_pos = glm::vec3(0.0, 10.0, 1.3);
-    glm::vec3 light_col = glm::vec3(1.0, 0.0, 0.0);
 
     float ambient = 0.8f;
     float diffuse = 0.7f;
     float specular = 0.7f;
     float shininess = 32.0f;
 
+    Light boardLight;
+    boardLight.position = light_pos;
+    boardLight.ambient = ambient;
+    boardLight.diffuse = diffuse;
+    boardLight.specular = specular;
+    boardLight.mask = BOARD_LIGHTS;
+    lightManager.add(boardLight);
+
     Checkers_Shader.use();
     Checkers_Shader.setFloat("shininess", shininess);
-    Checkers_Shader.setFloat("light.ambient_strength", ambient);
-    Checkers_Shader.setFloat("light.diffuse_strength", diffuse);
-    Checkers_Shader.setFloat("light.specular_strength", specular);
-    Checkers_Shader.setFloat("light.constant", 1.0);
-    Checkers_Shader.setFloat("light.linear", 0.14);
-    Checkers_Shader.setFloat("light.quadratic", 0.07);
+    Checkers_Shader.setInteger("light_mask", BOARD_LIGHTS);
+
+    Light globeLight;
+    globeLight.position = glm::vec3(13.0, 40.0, -78.0);
+    globeLight.ambient = 0.3f;
+    globeLight.diffuse = 0.8f;
+    globeLight.specular = 0.9f;
+    globeLight.mask = GLOBE_LIGHTS;
+    lightManager.add(globeLight);
 
     Globe_Shader.use();
-    Globe_Shader.setVector3f("light.position", glm::vec3(13.0, 40.0, -78.0));
     Globe_Shader.setFloat("shininess", 32.0f);
-    Globe_Shader.setFloat("light.ambient_strength", 0.3f);
-    Globe_Shader.setFloat("light.diffuse_strength", 0.8f);
-    Globe_Shader.setFloat("light.specular_strength", 0.9f);
-    Globe_Shader.setFloat("light.constant", 1.0);
-    Globe_Shader.setFloat("light.linear", 0.14);
-    Globe_Shader.setFloat("light.quadratic", 0.07);
+    Globe_Shader.setInteger("light_mask", GLOBE_LIGHTS);
 
 //Cubemap loading
-    GLuint cubeMapTexture;
-    glGenTextures(1, &cubeMapTexture);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTexture);
-
-    // texture parameters
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    //stbi_set_flip_vertically_on_load(true);
-
-    std::string pathToCubeMap = PATH_TO_TEXTURE "/cubemaps/Night/";
-
-    std::map<std::string, GLenum> facesToLoad = {
-            {pathToCubeMap + "px.png",GL_TEXTURE_CUBE_MAP_POSITIVE_X},
-            {pathToCubeMap + "py.png",GL_TEXTURE_CUBE_MAP_POSITIVE_Y},
-            {pathToCubeMap + "pz.png",GL_TEXTURE_CUBE_MAP_POSITIVE_Z},
-            {pathToCubeMap + "nx.png",GL_TEXTURE_CUBE_MAP_NEGATIVE_X},
-            {pathToCubeMap + "ny.png",GL_TEXTURE_CUBE_MAP_NEGATIVE_Y},
-            {pathToCubeMap + "nz.png",GL_TEXTURE_CUBE_MAP_NEGATIVE_Z},
-    };
-    //load the six faces
-    for (std::pair<std::string, GLenum> pair : facesToLoad) {
-        loadCubemapFace(pair.first.c_str(), pair.second);
-    }
+    // the environments C cycles through, Night is shown first and the next one is prefetched once the scene is loaded
+    SkyboxManager skyboxes(assets);
+    skyboxes.add("Night", SkyboxManager::faces(PATH_TO_TEXTURE "/cubemaps/Night/", { "px.png", "py.png", "pz.png", "nx.png", "ny.png", "nz.png" }));
+    skyboxes.add("Field", SkyboxManager::faces(PATH_TO_TEXTURE "/cubemaps/Field/", { "posx.png", "posy.png", "posz.png", "negx.png", "negy.png", "negz.png" }));
+    skyboxes.add("Apartment", SkyboxManager::faces(PATH_TO_TEXTURE "/cubemaps/Apartment/", { "posx.jpg", "posy.jpg", "posz.jpg", "negx.jpg", "negy.jpg", "negz.jpg" }));
+    skyboxes.select(0);
 
 
     // mark first pawn as selected
@@ -890,12 +887,26 @@ int main(int argc, char* argv[])
         }
     }
 
+    // view, projection and camera position for all programs, one upload per frame
+    FrameUniforms frameUniforms;
+    frameUniforms.create();
+
+    // the Checkers_Shader uniforms set for every piece and field, resolved once
+    Uniform<glm::mat4> checkersModel = Checkers_Shader.uniform<glm::mat4>("M");
+    Uniform<GLfloat> checkersSelected = Checkers_Shader.uniform<GLfloat>("selected");
+    Uniform<GLfloat> checkersLayer = Checkers_Shader.uniform<GLfloat>("layer");
+
     glfwSwapInterval(1);
 	//Rendering
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetKeyCallback(window, key_callback);
 
+	profiler.record("scene setup", "frame", "", setupStart, profiler.now() - setupStart);
+	int frameCount = 0;
+	bool startupRecorded = false;
+
 	while (!glfwWindowShouldClose(window)) {
+		int64_t frameStart = profiler.now();
         // reset unpermitted move global bool
         unpermitted_move = false;
 
@@ -906,6 +917,11 @@ int main(int argc, char* argv[])
 			processSelectedMeeple(window, Brightmeeples, Darkmeeples);
 		}
 
+		// upload whatever finished loading, a quarter of a 60 Hz frame at most
+		assets.update(0.004);
+		skyboxes.update();
+		shaderReloader.update();
+
 		view = camera.GetViewMatrix();
 		glfwPollEvents();
         glfwSetKeyCallback(window, key_callback); //Lookout for ALT keypress
@@ -933,52 +949,44 @@ int main(int argc, char* argv[])
 
 		}
 
+		// C switches to the next skybox, the current one stays until it is loaded
+		if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !cKeyPressed) {
+			skyboxes.next();
+			cKeyPressed = true;
+		}
+		else if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE) {
+			cKeyPressed = false;
+		}
+
 		// initialize rendering (send parameters to the shader)
+		frameUniforms.update(FrameData{ view, perspective, perspective * view, camera.Position, float(now) });
+		lightManager.update();
+
         Checkers_Shader.use();
-        Checkers_Shader.setMatrix4("V", view);
-        Checkers_Shader.setMatrix4("P", perspective);
-        Checkers_Shader.setVector3f("light.light_pos", light_pos);
-        Checkers_Shader.setVector3f("light.light_color", light_col);
-        Checkers_Shader.setVector3f("u_view_pos", camera.Position);
-
-        for (auto& meeple : Brightmeeples) {
-            Checkers_Shader.use();
-            Checkers_Shader.setMatrix4("M", meeple.model);
-            //Checkers_Shader.setMatrix4("itM", inverseModel);
-            Checkers_Shader.setInteger("ourTexture", 0);
-            Checkers_Shader.setFloat("selected", meeple.selected);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, Brightmeeple_texture);
-            glDepthFunc(GL_LEQUAL);
-            meeple.draw();
-        }
-        for (auto& meeple : Darkmeeples) {
-            Checkers_Shader.use();
-            Checkers_Shader.setMatrix4("M", meeple.model);
-            //Checkers_Shader.setMatrix4("itM", inverseModel);
-            Checkers_Shader.setInteger("ourTexture", 0);
-            Checkers_Shader.setFloat("selected", meeple.selected);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, Darkmeeple_texture);
-            glDepthFunc(GL_LEQUAL);
-            meeple.draw();
+
+        // the board and the pieces share one texture array: it is bound once, and only the per object uniforms
+        // (model, selection and texture layer) change between draws
+        Checkers_Shader.setInteger("ourTexture", 0);
+        glActiveTexture(GL_TEXTURE0);
+        glDepthFunc(GL_LEQUAL);
+        pieceTextures->bind();
+
+        for (std::vector<Object>* meeples : { &Brightmeeples, &Darkmeeples }) {
+            for (auto& meeple : *meeples) {
+                Checkers_Shader.set(checkersModel, meeple.getRenderModel());
+                //Checkers_Shader.setMatrix4("itM", inverseModel);
+                Checkers_Shader.set(checkersSelected, meeple.selected);
+                Checkers_Shader.set(checkersLayer, meeple.textureLayer);
+                meeple.draw(camera.Position, perspective, window_height);
+            }
         }
 
         // render the board
         for (int i = 0; i < board.size(); i++) {
             for (int j = 0; j < board.size(); j++) {
-                Checkers_Shader.use();
-                Checkers_Shader.setMatrix4("M", board[i][j].model);
-                Checkers_Shader.setInteger("ourTexture", 0);
-                Checkers_Shader.setFloat("selected", board[i][j].selected);
-                glActiveTexture(GL_TEXTURE0);
-                if (board[i][j].color == "white") {
-                    glBindTexture(GL_TEXTURE_2D, Board_Texture_1);
-                }
-                else {
-                    glBindTexture(GL_TEXTURE_2D, Board_Texture_2);
-                }
-                glDepthFunc(GL_LEQUAL);
+                Checkers_Shader.set(checkersModel, board[i][j].getRenderModel());
+                Checkers_Shader.set(checkersSelected, board[i][j].selected);
+                Checkers_Shader.set(checkersLayer, board[i][j].textureLayer);
                 board[i][j].draw();
             }
         }
@@ -986,33 +994,49 @@ int main(int argc, char* argv[])
         Room_Shader.use();
         Room_Shader.setMatrix4("M", room.model);
         Room_Shader.setMatrix4("itM", glm::transpose(glm::inverse(room.model)));
-        Room_Shader.setMatrix4("V", view);
-        Room_Shader.setMatrix4("P", perspective);
-        Room_Shader.setVector3f("u_view_pos", camera.Position);
         glDepthFunc(GL_LEQUAL);
-        room.draw();
+        room.drawMaterials(Room_Shader);
 
         Globe_Shader.use();
         Globe_Shader.setMatrix4("M", globe.model);
         Globe_Shader.setMatrix4("itM", glm::transpose(glm::inverse(globe.model)));
-        Globe_Shader.setMatrix4("V", view);
-        Globe_Shader.setMatrix4("P", perspective);
-        Globe_Shader.setVector3f("u_view_pos", camera.Position);
         Globe_Shader.setInteger("ourTexture", 0);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, glass_texture);
+        glass_texture->bind();
         glDepthFunc(GL_LEQUAL);
-        globe.draw();
+        globe.draw(camera.Position, perspective, window_height, &Globe_Shader);
 
         cubeMapShader.use();
-        cubeMapShader.setMatrix4("V", view);
-        cubeMapShader.setMatrix4("P", perspective);
         cubeMapShader.setInteger("cubemapTexture", 0);
+        glActiveTexture(GL_TEXTURE0);
+        skyboxes.current()->bind();
         cubeMap.draw();
         glDepthFunc(GL_LESS);
 
+		// until everything arrived the scene shows placeholders, with the loading progress on top
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		assets.drawProgress(framebufferWidth, framebufferHeight);
+
 		fps(now);
 		glfwSwapBuffers(window);
+
+		// the frames until everything is loaded make up the startup trace
+		if (!startupRecorded) {
+			profiler.record(frameCount == 0 ? "first frame" : "frame", "frame", "", frameStart, profiler.now() - frameStart);
+			if (assets.done()) {
+				profiler.mark("all assets loaded", "frame");
+				startupRecorded = true;
+				std::cout << "Textures: " << textures.size() << " (" << textures.gpuBytes() / 1024 << " KiB)" << std::endl;
+				if (!tracePath.empty()) {
+					profiler.writeChromeTrace(tracePath);
+				}
+				if (exitAfterLoad) {
+					glfwSetWindowShouldClose(window, true);
+				}
+			}
+		}
+		frameCount++;
 	}
 
 	//clean up resources
@@ -1022,26 +1046,6 @@ int main(int argc, char* argv[])
 }
 
 
-void loadCubemapFace(const char* path, const GLenum& targetFace)
-{
-	int imWidth, imHeight, imNrChannels;
-	stbi_set_flip_vertically_on_load(false);
-	unsigned char* data = stbi_load(path, &imWidth, &imHeight, &imNrChannels, 0);
-	if (data)
-	{
-
-		glTexImage2D(targetFace, 0, GL_RGB, imWidth, imHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		//glGenerateMipmap(targetFace);
-	}
-	else {
-		std::cout << "Failed to Load texture" << std::endl;
-		const char* reason = stbi_failure_reason();
-		std::cout << (reason == NULL ? "Probably not implemented by the student" : reason) << std::endl;
-	}
-	stbi_image_free(data);
-}
-
-
 //taken from https://learnopengl.com/Getting-started/Camera
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn) {
     float xpos = static_cast<float>(xposIn);
@@ -0,0 +1,146 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file mapped into memory.
+// The bytes stay valid as long as the MappedFile lives, so parsers can tokenize them in place
+class MappedFile
+{
+public:
+	MappedFile() {}
+
+	explicit MappedFile(const char* path) {
+		open(path);
+	}
+
+	~MappedFile() {
+		close();
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept {
+		*this = std::move(other);
+	}
+
+	MappedFile& operator=(MappedFile&& other) noexcept {
+		if (this != &other) {
+			close();
+			bytes = other.bytes;
+			length = other.length;
+#ifdef _WIN32
+			file = other.file;
+			mapping = other.mapping;
+			other.file = INVALID_HANDLE_VALUE;
+			other.mapping = NULL;
+#endif
+			other.bytes = nullptr;
+			other.length = 0;
+		}
+		return *this;
+	}
+
+	bool open(const char* path) {
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			close();
+			return false;
+		}
+		length = static_cast<size_t>(fileSize.QuadPart);
+		if (length == 0) {
+			return true;		// an empty file is valid, there is just nothing to map
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			close();
+			return false;
+		}
+		bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (bytes == nullptr) {
+			close();
+			return false;
+		}
+#else
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0) {
+			::close(fd);
+			return false;
+		}
+		length = static_cast<size_t>(info.st_size);
+		if (length == 0) {
+			::close(fd);
+			return true;
+		}
+		void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);		// the mapping keeps its own reference to the file
+		if (view == MAP_FAILED) {
+			length = 0;
+			return false;
+		}
+		madvise(view, length, MADV_SEQUENTIAL);
+		bytes = static_cast<const char*>(view);
+#endif
+		return true;
+	}
+
+	void close() {
+#ifdef _WIN32
+		if (bytes != nullptr) {
+			UnmapViewOfFile(bytes);
+		}
+		if (mapping != NULL) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (bytes != nullptr) {
+			munmap(const_cast<char*>(bytes), length);
+		}
+#endif
+		bytes = nullptr;
+		length = 0;
+	}
+
+	const char* data() const { return bytes; }
+	const char* end() const { return bytes + length; }
+	size_t size() const { return length; }
+	bool empty() const { return length == 0; }
+
+private:
+	const char* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#endif
+};
+#endif
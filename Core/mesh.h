@@ -0,0 +1,437 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include<iostream>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "mesh_cache.h"
+#include "mesh_indexer.h"
+#include "mesh_normals.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "mtl_parser.h"
+#include "obj_parser.h"
+#include "profiler.h"
+#include "texture_cache.h"
+#include "vertex.h"
+#include "vertex_format.h"
+
+// Geometry loaded from one .obj file together with its GL buffers.
+// A Mesh is shared by every Object drawn with it (see MeshRegistry), so it is never copied. Once makeObject uploaded
+// the geometry, the CPU copies (positions to tangents) are freed; the levels, submeshes, materials and bounds stay
+class Mesh
+{
+public:
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> textures;
+	std::vector<glm::vec3> normals;
+	std::vector<Vertex> vertices;		// every distinct vertex once
+	std::vector<uint32_t> indices;		// three per triangle, into vertices, every level of detail one after the other
+	std::vector<glm::vec4> tangents;	// one per vertex when the .obj has uvs, see MeshNormals::generateTangents
+	std::vector<MeshLod> lods;			// lods[0] is the full mesh, the others are simplified from it
+	std::vector<MeshSubmesh> submeshes;		// per level, one index range per material, see drawMaterials
+	std::vector<Material> materials;		// materials[0] for faces without usemtl, then one per usemtl name
+	std::vector<std::shared_ptr<Texture>> materialTextures;		// per material its diffuse map, if AssetLoader::loadMesh requested them
+	MeshBounds bounds;						// object space, i.e. under Object::model and not getRenderModel
+	std::atomic<bool> loaded{ false };		// set once load has filled everything above, from whichever thread ran it
+
+	int numVertices = 0;
+	int numIndices = 0;
+	GLenum indexType = GL_UNSIGNED_INT;		// GL_UNSIGNED_SHORT whenever the vertices fit
+
+	GLuint VBO = 0, VAO = 0, EBO = 0;
+	GLuint TBO = 0;		// tangents, only created for shaders with a tangent attribute
+
+	VertexFormat format = VertexFormat::Float32;		// layout chosen by makeObject
+	glm::mat4 positionDecode = glm::mat4(1.0f);			// object space from stored positions, part of Object::getRenderModel
+
+	std::shared_ptr<AssetFile> bakedMesh;		// .vrmesh from disk or the asset pack, only held until makeObject uploaded it
+	const Vertex* bakedVertices = nullptr;
+	const void* bakedIndices = nullptr;
+	const glm::vec4* bakedTangents = nullptr;
+
+	static const size_t LOD_MIN_TRIANGLES = 4096;		// lighter meshes are always drawn in full
+
+	Mesh() {}		// empty until load, draws nothing (see AssetLoader)
+
+	Mesh(const char* path) {
+		load(path);
+	}
+
+	// Fills the CPU side data from the .obj or its cache. Does not touch OpenGL, so it may run on a worker thread
+	// as long as nothing else uses the mesh meanwhile
+	void load(const char* path) {
+		ProfileScope loading("load mesh", "mesh", path);
+
+		// a valid .vrmesh next to the .obj already holds the interleaved vertices, it is uploaded straight from the mapping
+		AssetFile obj;
+		MeshSource source;
+		bool identified = false;
+		const MeshCacheHeader* header = nullptr;
+		{
+			ProfileScope reading("read", "io", path);		// mostly the hash, which pages in the whole .obj
+			if (!obj.open(path)) {
+				std::cout << "ERROR::MESH::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+			}
+			identified = obj.isOpen() && MeshCache::describe(path, obj, source);
+			if (identified) {
+				bakedMesh = MeshCache::load(path, source, header);
+			}
+		}
+		if (bakedMesh) {
+			bakedVertices = MeshCache::vertices(*bakedMesh, *header);
+			bakedIndices = MeshCache::indices(*bakedMesh, *header);
+			bakedTangents = MeshCache::tangents(*bakedMesh, *header);
+			numVertices = header->vertexCount;
+			numIndices = header->indexCount;
+			indexType = header->indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+			MeshCacheTables tables = MeshCache::tables(*bakedMesh, *header);
+			lods = tables.lods;
+			submeshes = tables.submeshes;
+			if (lods.empty()) {
+				lods.push_back(MeshLod{ 0, static_cast<uint32_t>(numIndices), 0.0f, 0 });
+			}
+			resolveMaterials(path, tables.materialLibraries, tables.materials);
+			bounds = tables.bounds;
+			std::cout << "Load model with " << numVertices << " vertices and " << numIndices << " indices (cached)" << std::endl;
+			loaded.store(true, std::memory_order_release);
+			return;
+		}
+
+		// The .obj file is tokenized in place by ObjParser:
+		// v, vt and vn records are collected and every f corner is expanded into a Vertex
+		ObjData data;
+		{
+			ProfileScope parsing("parse", "mesh", path);
+			ObjParser::parse(obj.data(), obj.end(), data);
+		}
+		positions = std::move(data.positions);
+		textures = std::move(data.textures);
+		normals = std::move(data.normals);
+		std::vector<uint32_t> triangleMaterials = ObjParser::triangleMaterials(data);
+		resolveMaterials(path, data.materialLibraries, data.materials);
+
+		// corners sharing position, uv and normal are welded into one vertex referenced by the index buffer
+		{
+			ProfileScope welding("weld", "mesh", path);
+			MeshIndexer::weld(data.vertices, vertices, indices);
+		}
+
+		// faces written as v or v/vt have no normal, they get smooth ones before anything looks at the normals
+		{
+			ProfileScope generating("generate normals", "mesh", path);
+			if (MeshNormals::generateNormals(vertices, indices)) {
+				std::cout << "  generated missing normals" << std::endl;
+			}
+		}
+		bounds = MeshBounds::compute(vertices.data(), vertices.size());
+
+		std::cout << "Load model with " << vertices.size() << " vertices and " << indices.size() << " indices" << std::endl;		// output text to console
+
+		// the triangles are grouped by material so each one is a single draw. Heavy meshes also get coarser index ranges
+		// over the same vertices, picked per draw by selectLod
+		{
+			ProfileScope simplifying("simplify", "mesh", path);
+			lods = MeshSimplifier::buildMaterialLods(vertices, indices, triangleMaterials, indices.size() / 3 >= LOD_MIN_TRIANGLES, submeshes);
+			for (size_t i = 1; i < lods.size(); i++) {
+				std::cout << "  LOD " << i << ": " << lods[i].indexCount / 3 << " triangles, error " << lods[i].error << std::endl;
+			}
+		}
+
+		// same triangles, ordered for the post transform cache and against overdraw, vertices in fetch order.
+		// Every submesh is reordered on its own so the material ranges stay intact
+		std::vector<std::pair<uint32_t, uint32_t>> ranges;
+		for (const MeshSubmesh& submesh : submeshes) {
+			ranges.push_back(std::make_pair(submesh.firstIndex, submesh.indexCount));
+		}
+		{
+			ProfileScope optimizing("optimize", "mesh", path);
+			MeshOptimizer::optimize(vertices, indices, ranges);
+		}
+
+		// tangents follow the final vertex order, so they come last
+		if (!textures.empty()) {
+			ProfileScope generating("generate tangents", "mesh", path);
+			tangents = MeshNormals::generateTangents(vertices, indices.data(), lods[0].indexCount);
+		}
+
+		numVertices = vertices.size();
+		numIndices = indices.size();
+		indexType = vertices.size() <= MeshIndexer::MAX_SHORT_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		if (identified) {
+			ProfileScope writing("write cache", "io", path);
+			MeshCacheTables tables;
+			tables.bounds = bounds;
+			tables.lods = lods;
+			tables.submeshes = submeshes;
+			tables.materialLibraries = data.materialLibraries;
+			tables.materials = data.materials;
+			tables.tangents = tangents;
+			if (indexType == GL_UNSIGNED_SHORT) {
+				std::vector<uint16_t> shortIndices = MeshIndexer::narrow(indices);
+				MeshCache::write(path, source, vertices, shortIndices.data(), numIndices, sizeof(uint16_t), tables);
+			}
+			else {
+				MeshCache::write(path, source, vertices, indices.data(), numIndices, sizeof(uint32_t), tables);
+			}
+		}
+		loaded.store(true, std::memory_order_release);
+	}
+
+	// Reads the .mtl libraries next to the .obj. The names come from the .obj or the cache while the .mtl files are
+	// read every time, so editing a material needs no rebuild of the .vrmesh. Unknown names keep the default material,
+	// diffuse maps are made relative to the .obj like the libraries
+	void resolveMaterials(const char* path, const std::vector<std::string>& libraries, const std::vector<std::string>& names) {
+		std::vector<Material> library;
+		for (const std::string& file : libraries) {
+			std::string libraryPath = MtlParser::libraryPath(path, file);
+			size_t first = library.size();
+			if (!MtlParser::parseFile(libraryPath, library)) {
+				std::cout << "WARNING::MESH::MATERIAL_LIBRARY_NOT_FOUND: " << file << std::endl;
+			}
+			for (size_t i = first; i < library.size(); i++) {
+				if (!library[i].diffuseMap.empty()) {
+					library[i].diffuseMap = MtlParser::libraryPath(libraryPath, library[i].diffuseMap);
+				}
+			}
+		}
+		materials.assign(names.size() + 1, Material());
+		for (size_t i = 0; i < names.size(); i++) {
+			materials[i + 1].name = names[i];
+			for (const Material& material : library) {
+				if (material.name == names[i]) {
+					materials[i + 1] = material;
+				}
+			}
+		}
+	}
+
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+
+	~Mesh() {
+		// the last handle may go away after the window (and its context) was destroyed
+		if (VAO != 0 && glfwGetCurrentContext() != nullptr) {
+			glDeleteVertexArrays(1, &VAO);
+			glDeleteBuffers(1, &VBO);
+			glDeleteBuffers(1, &EBO);
+			glDeleteBuffers(1, &TBO);
+		}
+	}
+
+	// Creates the GL buffers the first time it is called, later calls are no-ops since all instances share them.
+	// The attribute locations are taken from the shader passed in the first call.
+	// A compact vertexFormat halves the vertex size, the attribute setup follows it and the shaders stay the same
+	void makeObject(Shader shader, bool texture = true, VertexFormat vertexFormat = VertexFormat::Float32) {
+		if (VAO != 0) {
+			return;
+		}
+		ProfileScope uploading("upload mesh", "gl");
+
+		//Create the VAO and VBO
+		//Put your data into your VBO
+		//Define VBO and VAO as active buffer and active vertex array
+		//Use the VAO to specify how your data should be read by your shader (glVertexAttribPointer and co)
+		//Sometimes your shader will not use texture or normal attribute
+		//you can use the boolean defined above to not specify these attribute 
+		//desactive the buffer and delete the datas when your done
+
+
+		/* This is a working but not perfect solution, you can improve it if you need/want
+		* What happens if you call this function twice on an Model ?
+		* What happens when a shader doesn't have a position, tex_coord or normal attribute ?
+		*/
+
+		// Vertex is already the interleaved 8 float layout, so the data is uploaded without repacking
+		const Vertex* data = bakedVertices != nullptr ? bakedVertices : vertices.data();
+		format = vertexFormat;
+
+		std::vector<CompactVertex> compact;
+		bool normalizedTexture = false;
+		const void* vertexData = data;
+		size_t vertexSize = sizeof(Vertex);
+		if (format != VertexFormat::Float32) {
+			compact = VertexPacker::pack(data, numVertices, format, positionDecode, normalizedTexture);
+			vertexData = compact.data();
+			vertexSize = sizeof(CompactVertex);
+		}
+
+		std::vector<uint16_t> shortIndices;
+		const void* indexData = bakedIndices;
+		if (indexData == nullptr) {
+			if (indexType == GL_UNSIGNED_SHORT) {
+				shortIndices = MeshIndexer::narrow(indices);
+				indexData = shortIndices.data();
+			}
+			else {
+				indexData = indices.data();
+			}
+		}
+		size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+
+		//define VBO and VAO as active buffer and active vertex array
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, vertexSize * numVertices, vertexData, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);		// recorded in the VAO, stays bound with it
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize * numIndices, indexData, GL_STATIC_DRAW);
+
+		auto att_pos = glGetAttribLocation(shader.id(), "position");
+		auto att_tex = glGetAttribLocation(shader.id(), "tex_coord");
+		auto att_col = glGetAttribLocation(shader.id(), "normal");
+		glEnableVertexAttribArray(att_pos);
+		glEnableVertexAttribArray(att_col);
+		if (texture) {
+			glEnableVertexAttribArray(att_tex);
+		}
+
+		if (format == VertexFormat::Float32) {
+			glVertexAttribPointer(att_pos, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)0);
+			if (texture) {
+				glVertexAttribPointer(att_tex, 2, GL_FLOAT, false, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+			}
+			glVertexAttribPointer(att_col, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)(5 * sizeof(float)));
+		}
+		else {
+			GLsizei stride = sizeof(CompactVertex);
+			if (format == VertexFormat::Snorm16) {
+				glVertexAttribPointer(att_pos, 3, GL_SHORT, true, stride, (void*)offsetof(CompactVertex, Position));
+			}
+			else {
+				glVertexAttribPointer(att_pos, 3, GL_HALF_FLOAT, false, stride, (void*)offsetof(CompactVertex, Position));
+			}
+			if (texture) {
+				glVertexAttribPointer(att_tex, 2, normalizedTexture ? GL_UNSIGNED_SHORT : GL_HALF_FLOAT, normalizedTexture, stride, (void*)offsetof(CompactVertex, Texture));
+			}
+			// packed normals always come with 4 components, the shader only reads xyz
+			glVertexAttribPointer(att_col, 4, GL_INT_2_10_10_10_REV, true, stride, (void*)offsetof(CompactVertex, Normal));
+		}
+
+		// tangents live in their own buffer so every vertex format keeps its layout
+		const glm::vec4* tangentData = bakedTangents != nullptr ? bakedTangents : (tangents.empty() ? nullptr : tangents.data());
+		GLint att_tan = glGetAttribLocation(shader.id(), "tangent");
+		if (att_tan >= 0 && tangentData != nullptr) {
+			glGenBuffers(1, &TBO);
+			glBindBuffer(GL_ARRAY_BUFFER, TBO);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * numVertices, tangentData, GL_STATIC_DRAW);
+			glEnableVertexAttribArray(att_tan);
+			glVertexAttribPointer(att_tan, 4, GL_FLOAT, false, sizeof(glm::vec4), (void*)0);
+		}
+
+		//desactive the buffer
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+
+		// the GL buffer owns the data now, unmap the cache file and free the CPU copies
+		bakedMesh.reset();
+		bakedVertices = nullptr;
+		bakedIndices = nullptr;
+		bakedTangents = nullptr;
+		releaseGeometry();
+	}
+
+	void releaseGeometry() {
+		positions.clear();
+		positions.shrink_to_fit();
+		textures.clear();
+		textures.shrink_to_fit();
+		normals.clear();
+		normals.shrink_to_fit();
+		vertices.clear();
+		vertices.shrink_to_fit();
+		indices.clear();
+		indices.shrink_to_fit();
+		tangents.clear();
+		tangents.shrink_to_fit();
+	}
+
+	// Coarsest level whose error stays below pixelThreshold pixels on screen. distance is measured from the camera,
+	// scale is the largest scale factor of the model matrix, projection[1][1] carries the field of view
+	int selectLod(float distance, float scale, const glm::mat4& projection, float viewportHeight, float pixelThreshold = 1.0f) const {
+		float pixelsPerUnit = scale * projection[1][1] * 0.5f * viewportHeight / glm::max(distance, 1e-4f);
+		int level = 0;
+		for (size_t i = 1; i < lods.size(); i++) {
+			if (lods[i].error * pixelsPerUnit < pixelThreshold) {
+				level = static_cast<int>(i);
+			}
+		}
+		return level;
+	}
+
+	// the submeshes of one level, in material order
+	std::vector<MeshSubmesh> submeshesOf(int level) const {
+		std::vector<MeshSubmesh> result;
+		for (const MeshSubmesh& submesh : submeshes) {
+			if (submesh.lod == static_cast<uint32_t>(level)) {
+				result.push_back(submesh);
+			}
+		}
+		return result;
+	}
+
+	// one material of one level, for callers that bind materials[submesh.material] themselves.
+	// draw covers all materials of a level in one call, drawMaterials one call per material
+	void drawSubmesh(const MeshSubmesh& submesh) {
+		if (VAO == 0) {
+			return;
+		}
+		size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+		glBindVertexArray(this->VAO);
+		glDrawElements(GL_TRIANGLES, submesh.indexCount, indexType, (void*)(submesh.firstIndex * indexSize));
+	}
+
+	// Draws level one material at a time. The faces without usemtl come first with whatever the caller set; the others
+	// set materialColour to their Kd and bind their diffuse map to texture unit 0, where the shader has them. The
+	// caller's materialColour is set again afterwards, the texture of the last material stays bound. A mesh without
+	// materials is drawn in one call like draw
+	void drawMaterials(Shader& shader, int level = 0) {
+		if (VAO == 0 || materials.size() <= 1) {
+			draw(level);
+			return;
+		}
+		Uniform<glm::vec3> colour = shader.uniform<glm::vec3>("materialColour");
+		glm::vec3 callerColour;
+		bool restore = shader.get(colour, callerColour);
+		for (const MeshSubmesh& submesh : submeshes) {
+			if (submesh.lod != static_cast<uint32_t>(level)) {
+				continue;
+			}
+			if (submesh.material > 0) {
+				shader.set(colour, materials[submesh.material].diffuse);
+				if (submesh.material < materialTextures.size() && materialTextures[submesh.material]) {
+					glActiveTexture(GL_TEXTURE0);
+					materialTextures[submesh.material]->bind();
+				}
+			}
+			drawSubmesh(submesh);
+		}
+		if (restore) {
+			shader.set(colour, callerColour);
+		}
+	}
+
+	void draw(int level = 0) {
+		if (VAO == 0) {
+			return;		// not uploaded yet
+		}
+		const MeshLod& lod = lods[level];
+		size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+		glBindVertexArray(this->VAO);
+		glDrawElements(GL_TRIANGLES, lod.indexCount, indexType, (void*)(lod.firstIndex * indexSize));
+	}
+};
+#endif
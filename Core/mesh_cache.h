@@ -0,0 +1,291 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <glm/glm.hpp>
+
+#include "asset_pack.h"
+#include "bounds.h"
+#include "mesh_simplifier.h"
+#include "vertex.h"
+
+// Identity of the .obj a baked mesh was generated from
+struct MeshSource {
+	uint64_t size = 0;
+	int64_t mtime = 0;
+	uint64_t hash = 0;
+};
+
+// Header of a .vrmesh file. It is followed by the interleaved Vertex array, the index array, the MeshLod and MeshSubmesh
+// tables, the material names and the tangents, all starting at 16 byte aligned offsets so the arrays can be handed to glBufferData
+// straight from the mapping
+struct MeshCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint64_t sourceSize;
+	int64_t sourceMtime;
+	uint64_t sourceHash;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexSize;		// bytes per index, 0 when the mesh is drawn without an element buffer
+	uint32_t lodCount;		// levels of detail stored in the index array, 0 for a single full level
+	float boundsMin[3];
+	float boundsMax[3];
+	float sphereCenter[3];
+	float sphereRadius;
+	uint32_t submeshCount;
+	uint32_t libraryCount;		// the name table holds the mtllib files first, then the material names
+	uint32_t materialCount;
+	uint32_t tangentCount;		// 0 or vertexCount
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t lodOffset;
+	uint64_t submeshOffset;
+	uint64_t nameOffset;
+	uint64_t tangentOffset;
+	uint64_t payloadHash;	// hash of everything after the header, catches truncated or damaged files
+};
+
+// The tables stored next to the vertex and index data, and the bounds kept in the header
+struct MeshCacheTables {
+	MeshBounds bounds;
+	std::vector<MeshLod> lods;
+	std::vector<MeshSubmesh> submeshes;
+	std::vector<std::string> materialLibraries;
+	std::vector<std::string> materials;
+	std::vector<glm::vec4> tangents;		// only used by write, a loaded mesh reads them through MeshCache::tangents
+};
+
+// Binary cache of the final vertex/index data of an .obj, stored next to it as <name>.vrmesh.
+// The cache is only used while size, modification time and content hash of the .obj still match
+class MeshCache
+{
+public:
+	static const uint32_t VERSION = 7;		// bump whenever the layout or the meaning of the stored data changes
+
+	// when set, existing caches are ignored and written anew, e.g. to measure a cold start
+	static bool& forceRebuild() {
+		static bool force = false;
+		return force;
+	}
+
+	static const size_t NAME_LENGTH = 64;		// bytes per name in the name table, zero terminated
+
+	static std::string cachePathFor(const char* objPath) {
+		std::string path(objPath);
+		size_t dot = path.find_last_of('.');
+		size_t slash = path.find_last_of("/\\");
+		if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+			path.erase(dot);
+		}
+		return path + ".vrmesh";
+	}
+
+	static uint64_t hashBytes(const char* data, size_t size) {
+		return AssetPack::hashBytes(data, size);
+	}
+
+	// stat and hash the already opened .obj. An .obj from the asset pack is described by its table of contents entry,
+	// so a cache hit never reads it
+	static bool describe(const char* objPath, const AssetFile& obj, MeshSource& source) {
+		if (const AssetPackEntry* entry = obj.packEntry()) {
+			source.size = entry->size;
+			source.mtime = entry->mtime;
+			source.hash = entry->hash;
+			return true;
+		}
+		struct stat info;
+		if (stat(objPath, &info) != 0) {
+			return false;
+		}
+		source.size = static_cast<uint64_t>(info.st_size);
+		source.mtime = static_cast<int64_t>(info.st_mtime);
+		source.hash = hashBytes(obj.data(), obj.size());
+		return true;
+	}
+
+	// Maps the cache belonging to objPath. Returns nullptr if there is none or if it is stale or corrupt,
+	// in that case the caller parses the .obj and writes a new one
+	static std::shared_ptr<AssetFile> load(const char* objPath, const MeshSource& source, const MeshCacheHeader*& header) {
+		header = nullptr;
+		if (forceRebuild()) {
+			return nullptr;
+		}
+		std::shared_ptr<AssetFile> file = std::make_shared<AssetFile>();
+		if (!file->open(cachePathFor(objPath).c_str())) {
+			return nullptr;
+		}
+		if (file->data() == nullptr || file->size() < sizeof(MeshCacheHeader)) {
+			return nullptr;
+		}
+		const MeshCacheHeader* h = reinterpret_cast<const MeshCacheHeader*>(file->data());
+		if (std::memcmp(h->magic, "VRMESH\0", 8) != 0 || h->version != VERSION || h->headerSize != sizeof(MeshCacheHeader)) {
+			return nullptr;
+		}
+		if (h->sourceSize != source.size || h->sourceMtime != source.mtime || h->sourceHash != source.hash) {
+			return nullptr;		// the .obj changed since the cache was written
+		}
+		uint64_t vertexBytes = uint64_t(h->vertexCount) * sizeof(Vertex);
+		uint64_t indexBytes = uint64_t(h->indexCount) * h->indexSize;
+		uint64_t lodBytes = uint64_t(h->lodCount) * sizeof(MeshLod);
+		uint64_t submeshBytes = uint64_t(h->submeshCount) * sizeof(MeshSubmesh);
+		uint64_t nameBytes = (uint64_t(h->libraryCount) + h->materialCount) * NAME_LENGTH;
+		uint64_t tangentBytes = uint64_t(h->tangentCount) * sizeof(glm::vec4);
+		if (h->vertexOffset % 16 != 0 || h->indexOffset % 16 != 0 || h->lodOffset % 16 != 0 || h->submeshOffset % 16 != 0 || h->nameOffset % 16 != 0 ||
+			h->tangentOffset % 16 != 0 || (h->tangentCount != 0 && h->tangentCount != h->vertexCount) ||
+			h->vertexOffset < sizeof(MeshCacheHeader) || h->vertexOffset + vertexBytes > file->size() ||
+			h->indexOffset < h->vertexOffset + vertexBytes || h->indexOffset + indexBytes > file->size() ||
+			h->lodOffset < h->indexOffset + indexBytes || h->lodOffset + lodBytes > file->size() ||
+			h->submeshOffset < h->lodOffset + lodBytes || h->submeshOffset + submeshBytes > file->size() ||
+			h->nameOffset < h->submeshOffset + submeshBytes || h->nameOffset + nameBytes > file->size() ||
+			h->tangentOffset < h->nameOffset + nameBytes || h->tangentOffset + tangentBytes > file->size()) {
+			return nullptr;
+		}
+		const char* payload = file->data() + sizeof(MeshCacheHeader);
+		if (hashBytes(payload, file->size() - sizeof(MeshCacheHeader)) != h->payloadHash) {
+			std::cout << "WARNING::MESH_CACHE::CORRUPT: " << cachePathFor(objPath) << std::endl;
+			return nullptr;
+		}
+		header = h;
+		return file;
+	}
+
+	static const Vertex* vertices(const AssetFile& file, const MeshCacheHeader& header) {
+		return reinterpret_cast<const Vertex*>(file.data() + header.vertexOffset);
+	}
+
+	static const void* indices(const AssetFile& file, const MeshCacheHeader& header) {
+		return file.data() + header.indexOffset;
+	}
+
+	// one per vertex, nullptr if the mesh was stored without tangents
+	static const glm::vec4* tangents(const AssetFile& file, const MeshCacheHeader& header) {
+		return header.tangentCount == 0 ? nullptr : reinterpret_cast<const glm::vec4*>(file.data() + header.tangentOffset);
+	}
+
+	static MeshCacheTables tables(const AssetFile& file, const MeshCacheHeader& header) {
+		MeshCacheTables tables;
+		const MeshLod* lods = reinterpret_cast<const MeshLod*>(file.data() + header.lodOffset);
+		tables.lods.assign(lods, lods + header.lodCount);
+		if (header.vertexCount > 0) {
+			tables.bounds.box.min = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+			tables.bounds.box.max = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+			tables.bounds.sphere.center = glm::vec3(header.sphereCenter[0], header.sphereCenter[1], header.sphereCenter[2]);
+			tables.bounds.sphere.radius = header.sphereRadius;
+		}
+		const MeshSubmesh* submeshes = reinterpret_cast<const MeshSubmesh*>(file.data() + header.submeshOffset);
+		tables.submeshes.assign(submeshes, submeshes + header.submeshCount);
+		const char* name = file.data() + header.nameOffset;
+		for (uint32_t i = 0; i < header.libraryCount + header.materialCount; i++, name += NAME_LENGTH) {
+			std::string text(name, strnlen(name, NAME_LENGTH));
+			(i < header.libraryCount ? tables.materialLibraries : tables.materials).push_back(text);
+		}
+		return tables;
+	}
+
+	// Writes the cache to a temporary file first and renames it, so a crash never leaves a half written .vrmesh behind
+	static bool write(const char* objPath, const MeshSource& source, const std::vector<Vertex>& vertices,
+		const void* indices = nullptr, uint32_t indexCount = 0, uint32_t indexSize = 0, const MeshCacheTables& tables = MeshCacheTables()) {
+		std::vector<std::string> names(tables.materialLibraries);
+		names.insert(names.end(), tables.materials.begin(), tables.materials.end());
+		for (const std::string& name : names) {
+			if (name.size() >= NAME_LENGTH) {
+				std::cout << "WARNING::MESH_CACHE::NAME_TOO_LONG: " << name << std::endl;
+				return false;
+			}
+		}
+
+		MeshCacheHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, "VRMESH\0", 8);
+		header.version = VERSION;
+		header.headerSize = sizeof(MeshCacheHeader);
+		header.sourceSize = source.size;
+		header.sourceMtime = source.mtime;
+		header.sourceHash = source.hash;
+		header.vertexCount = static_cast<uint32_t>(vertices.size());
+		header.indexCount = indexCount;
+		header.indexSize = indexSize;
+		header.lodCount = static_cast<uint32_t>(tables.lods.size());
+		header.submeshCount = static_cast<uint32_t>(tables.submeshes.size());
+		header.libraryCount = static_cast<uint32_t>(tables.materialLibraries.size());
+		header.materialCount = static_cast<uint32_t>(tables.materials.size());
+		header.tangentCount = tables.tangents.size() == vertices.size() ? static_cast<uint32_t>(vertices.size()) : 0;
+
+		for (int i = 0; i < 3; i++) {
+			header.boundsMin[i] = tables.bounds.box.min[i];
+			header.boundsMax[i] = tables.bounds.box.max[i];
+			header.sphereCenter[i] = tables.bounds.sphere.center[i];
+		}
+		header.sphereRadius = tables.bounds.sphere.radius;
+
+		size_t vertexBytes = vertices.size() * sizeof(Vertex);
+		size_t indexBytes = size_t(indexCount) * indexSize;
+		size_t lodBytes = tables.lods.size() * sizeof(MeshLod);
+		size_t submeshBytes = tables.submeshes.size() * sizeof(MeshSubmesh);
+		size_t nameBytes = names.size() * NAME_LENGTH;
+		size_t tangentBytes = size_t(header.tangentCount) * sizeof(glm::vec4);
+		header.vertexOffset = align16(sizeof(MeshCacheHeader));
+		header.indexOffset = align16(header.vertexOffset + vertexBytes);
+		header.lodOffset = align16(header.indexOffset + indexBytes);
+		header.submeshOffset = align16(header.lodOffset + lodBytes);
+		header.nameOffset = align16(header.submeshOffset + submeshBytes);
+
+		header.tangentOffset = align16(header.nameOffset + nameBytes);
+
+		std::vector<char> payload(header.tangentOffset + tangentBytes - sizeof(MeshCacheHeader), 0);
+		if (vertexBytes > 0) {
+			std::memcpy(payload.data() + header.vertexOffset - sizeof(MeshCacheHeader), vertices.data(), vertexBytes);
+		}
+		if (indexBytes > 0) {
+			std::memcpy(payload.data() + header.indexOffset - sizeof(MeshCacheHeader), indices, indexBytes);
+		}
+		if (lodBytes > 0) {
+			std::memcpy(payload.data() + header.lodOffset - sizeof(MeshCacheHeader), tables.lods.data(), lodBytes);
+		}
+		if (submeshBytes > 0) {
+			std::memcpy(payload.data() + header.submeshOffset - sizeof(MeshCacheHeader), tables.submeshes.data(), submeshBytes);
+		}
+		for (size_t i = 0; i < names.size(); i++) {
+			std::memcpy(payload.data() + header.nameOffset - sizeof(MeshCacheHeader) + i * NAME_LENGTH, names[i].data(), names[i].size());
+		}
+		if (tangentBytes > 0) {
+			std::memcpy(payload.data() + header.tangentOffset - sizeof(MeshCacheHeader), tables.tangents.data(), tangentBytes);
+		}
+		header.payloadHash = hashBytes(payload.data(), payload.size());
+
+		std::string path = cachePathFor(objPath);
+		std::string temporary = path + ".tmp";
+		FILE* file = std::fopen(temporary.c_str(), "wb");
+		if (file == nullptr) {
+			std::cout << "WARNING::MESH_CACHE::CANNOT_WRITE: " << path << std::endl;
+			return false;
+		}
+		bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+			(payload.empty() || std::fwrite(payload.data(), payload.size(), 1, file) == 1);
+		written = std::fclose(file) == 0 && written;
+		std::remove(path.c_str());		// rename does not replace an existing file on Windows
+		if (!written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+			std::remove(temporary.c_str());
+			std::cout << "WARNING::MESH_CACHE::CANNOT_WRITE: " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+private:
+	static uint64_t align16(uint64_t offset) {
+		return (offset + 15) & ~uint64_t(15);
+	}
+};
+#endif
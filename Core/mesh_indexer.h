@@ -0,0 +1,101 @@
+#ifndef MESH_INDEXER_H
+#define MESH_INDEXER_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "vertex.h"
+
+// Welds bitwise identical vertices of a triangle list and builds the matching index buffer
+class MeshIndexer
+{
+public:
+	// largest vertex count that still fits a 16 bit index buffer
+	static const size_t MAX_SHORT_VERTICES = 65536;
+
+	// expanded holds three vertices per triangle (what ObjParser produces).
+	// unique receives every distinct vertex once in order of first use, indices one entry per expanded vertex
+	static void weld(const std::vector<Vertex>& expanded, std::vector<Vertex>& unique, std::vector<uint32_t>& indices) {
+		unique.clear();
+		indices.clear();
+		unique.reserve(expanded.size() / 2);
+		indices.reserve(expanded.size());
+
+		// open addressing table of indices into unique, sized to stay at most half full
+		size_t capacity = 16;
+		while (capacity < expanded.size() * 2) {
+			capacity <<= 1;
+		}
+		const uint32_t empty = 0xffffffffu;
+		std::vector<uint32_t> table(capacity, empty);
+		size_t mask = capacity - 1;
+
+		for (const Vertex& v : expanded) {
+			size_t slot = hash(v) & mask;
+			while (true) {
+				uint32_t candidate = table[slot];
+				if (candidate == empty) {
+					table[slot] = static_cast<uint32_t>(unique.size());
+					indices.push_back(static_cast<uint32_t>(unique.size()));
+					unique.push_back(v);
+					break;
+				}
+				if (std::memcmp(&unique[candidate], &v, sizeof(Vertex)) == 0) {
+					indices.push_back(candidate);
+					break;
+				}
+				slot = (slot + 1) & mask;
+			}
+		}
+	}
+
+	// Numbers the distinct positions of vertices: group[i] is shared by every vertex at the position of vertices[i],
+	// whatever its uv and normal. Returns the number of groups
+	static size_t positionGroups(const std::vector<Vertex>& vertices, std::vector<uint32_t>& group) {
+		group.resize(vertices.size());
+		size_t capacity = 16;
+		while (capacity < vertices.size() * 2) {
+			capacity <<= 1;
+		}
+		const uint32_t empty = 0xffffffffu;
+		std::vector<uint32_t> table(capacity, empty);		// first vertex of each group
+		size_t mask = capacity - 1;
+		size_t count = 0;
+
+		for (size_t i = 0; i < vertices.size(); i++) {
+			size_t slot = hash(vertices[i].Position) & mask;
+			while (true) {
+				uint32_t candidate = table[slot];
+				if (candidate == empty) {
+					table[slot] = static_cast<uint32_t>(i);
+					group[i] = static_cast<uint32_t>(count++);
+					break;
+				}
+				if (std::memcmp(&vertices[candidate].Position, &vertices[i].Position, sizeof(glm::vec3)) == 0) {
+					group[i] = group[candidate];
+					break;
+				}
+				slot = (slot + 1) & mask;
+			}
+		}
+		return count;
+	}
+
+	static std::vector<uint16_t> narrow(const std::vector<uint32_t>& indices) {
+		return std::vector<uint16_t>(indices.begin(), indices.end());
+	}
+
+private:
+	template<typename T>
+	static size_t hash(const T& v) {
+		uint32_t words[sizeof(T) / 4];
+		std::memcpy(words, &v, sizeof(T));
+		uint64_t h = 0xcbf29ce484222325ull;
+		for (uint32_t word : words) {
+			h = (h ^ word) * 0x100000001b3ull;
+		}
+		return static_cast<size_t>(h ^ (h >> 32));
+	}
+};
+#endif
@@ -0,0 +1,192 @@
+#ifndef MESH_NORMALS_H
+#define MESH_NORMALS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh_indexer.h"
+#include "thread_pool.h"
+#include "vertex.h"
+
+// How the faces around a vertex contribute to its normal
+enum class NormalWeighting {
+	Area,		// plain smooth normals, large faces dominate
+	Angle,		// by the angle of the face at the vertex (Thuermer & Wuethrich), independent of how the surface is triangulated
+};
+
+// Fills in normals an .obj did not provide and derives tangents from the uvs.
+// Both run in three steps: every triangle computes its contribution on its own, the corners are grouped per vertex,
+// and every vertex sums its corners. Each step only writes its own elements, so the threads need neither atomics
+// nor locks, and the sums are taken in a fixed order so the result does not depend on the thread count
+class MeshNormals
+{
+public:
+	// triangles per block handed to a thread, smaller meshes stay on the calling thread
+	static const size_t BLOCK_SIZE = 16384;
+
+	// Gives every vertex whose normal is zero (a corner without vn) the normalized sum over the faces around its position.
+	// Vertices at the same position share the normal even across uv seams. Returns false if no normal was missing
+	static bool generateNormals(std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, NormalWeighting weighting = NormalWeighting::Angle) {
+		bool missing = false;
+		for (const Vertex& v : vertices) {
+			missing = missing || v.Normal == glm::vec3(0.0f);
+		}
+		if (!missing) {
+			return false;
+		}
+
+		size_t triangles = indices.size() / 3;
+		std::vector<glm::vec3> cornerNormals(triangles * 3);
+		forEachBlock(triangles, [&](size_t begin, size_t end) {
+			for (size_t t = begin; t < end; t++) {
+				const uint32_t* corner = &indices[t * 3];
+				glm::vec3 a = vertices[corner[0]].Position, b = vertices[corner[1]].Position, c = vertices[corner[2]].Position;
+				glm::vec3 face = glm::cross(b - a, c - a);		// twice the area long
+				if (weighting == NormalWeighting::Area) {
+					cornerNormals[t * 3] = cornerNormals[t * 3 + 1] = cornerNormals[t * 3 + 2] = face;
+					continue;
+				}
+				float length = glm::length(face);
+				glm::vec3 n = length > 0.0f ? face / length : glm::vec3(0.0f);
+				cornerNormals[t * 3] = n * angle(a, b, c);
+				cornerNormals[t * 3 + 1] = n * angle(b, c, a);
+				cornerNormals[t * 3 + 2] = n * angle(c, a, b);
+			}
+		});
+
+		std::vector<uint32_t> group;
+		size_t groups = MeshIndexer::positionGroups(vertices, group);
+		std::vector<uint32_t> start, corners;
+		groupCorners(indices.data(), indices.size(), group, groups, start, corners);
+
+		std::vector<glm::vec3> groupNormals(groups);
+		forEachBlock(groups, [&](size_t begin, size_t end) {
+			for (size_t g = begin; g < end; g++) {
+				glm::vec3 sum(0.0f);
+				for (uint32_t i = start[g]; i < start[g + 1]; i++) {
+					sum += cornerNormals[corners[i]];
+				}
+				float length = glm::length(sum);
+				groupNormals[g] = length > 0.0f ? sum / length : glm::vec3(0.0f, 1.0f, 0.0f);		// isolated or fully degenerate
+			}
+		});
+
+		forEachBlock(vertices.size(), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				if (vertices[i].Normal == glm::vec3(0.0f)) {
+					vertices[i].Normal = groupNormals[group[i]];
+				}
+			}
+		});
+		return true;
+	}
+
+	// Per vertex tangents in the MikkTSpace convention: xyz is the tangent along +u, orthogonal to the normal,
+	// w = +-1 is the handedness so that bitangent = w * cross(normal, tangent). Corners are weighted by their angle like
+	// MikkTSpace does, but vertices with mirrored uvs on either side are not split, they get the sum of both.
+	// Only the first indexCount indices (the full level of detail) are used
+	static std::vector<glm::vec4> generateTangents(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount) {
+		size_t triangles = indexCount / 3;
+		std::vector<glm::vec3> cornerTangents(triangles * 3), cornerBitangents(triangles * 3);
+		forEachBlock(triangles, [&](size_t begin, size_t end) {
+			for (size_t t = begin; t < end; t++) {
+				const uint32_t* corner = &indices[t * 3];
+				const Vertex* v[3] = { &vertices[corner[0]], &vertices[corner[1]], &vertices[corner[2]] };
+				glm::vec3 e1 = v[1]->Position - v[0]->Position, e2 = v[2]->Position - v[0]->Position;
+				glm::vec2 d1 = v[1]->Texture - v[0]->Texture, d2 = v[2]->Texture - v[0]->Texture;
+				float determinant = d1.x * d2.y - d2.x * d1.y;
+				glm::vec3 tangent(0.0f), bitangent(0.0f);
+				if (determinant != 0.0f) {
+					// the sign of the determinant is the orientation of the uvs, the length does not matter after normalizing
+					float sign = determinant > 0.0f ? 1.0f : -1.0f;
+					tangent = (e1 * d2.y - e2 * d1.y) * sign;
+					bitangent = (e2 * d1.x - e1 * d2.x) * sign;
+				}
+				for (int k = 0; k < 3; k++) {
+					glm::vec3 n = v[k]->Normal;
+					glm::vec3 projected = tangent - n * glm::dot(n, tangent);
+					float length = glm::length(projected);
+					float weight = angle(v[k]->Position, v[(k + 1) % 3]->Position, v[(k + 2) % 3]->Position);
+					cornerTangents[t * 3 + k] = length > 0.0f ? projected / length * weight : glm::vec3(0.0f);
+					projected = bitangent - n * glm::dot(n, bitangent);
+					length = glm::length(projected);
+					cornerBitangents[t * 3 + k] = length > 0.0f ? projected / length * weight : glm::vec3(0.0f);
+				}
+			}
+		});
+
+		std::vector<uint32_t> identity(vertices.size());
+		for (size_t i = 0; i < identity.size(); i++) {
+			identity[i] = static_cast<uint32_t>(i);
+		}
+		std::vector<uint32_t> start, corners;
+		groupCorners(indices, triangles * 3, identity, vertices.size(), start, corners);
+
+		std::vector<glm::vec4> tangents(vertices.size());
+		forEachBlock(vertices.size(), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				glm::vec3 tangent(0.0f), bitangent(0.0f);
+				for (uint32_t c = start[i]; c < start[i + 1]; c++) {
+					tangent += cornerTangents[corners[c]];
+					bitangent += cornerBitangents[corners[c]];
+				}
+				glm::vec3 n = vertices[i].Normal;
+				tangent -= n * glm::dot(n, tangent);
+				float length = glm::length(tangent);
+				if (length > 0.0f) {
+					tangent /= length;
+				}
+				else {
+					// no usable uvs around this vertex, any direction orthogonal to the normal
+					tangent = glm::normalize(glm::abs(n.x) < 0.9f ? glm::cross(n, glm::vec3(1.0f, 0.0f, 0.0f)) : glm::cross(n, glm::vec3(0.0f, 1.0f, 0.0f)));
+				}
+				float handedness = glm::dot(glm::cross(n, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+				tangents[i] = glm::vec4(tangent, handedness);
+			}
+		});
+		return tangents;
+	}
+
+private:
+	// angle at a between the edges to b and c
+	static float angle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+		glm::vec3 u = b - a, v = c - a;
+		float lengths = glm::length(u) * glm::length(v);
+		return lengths > 0.0f ? glm::acos(glm::clamp(glm::dot(u, v) / lengths, -1.0f, 1.0f)) : 0.0f;
+	}
+
+	// Corners listed per group, a counting sort: the corners of group g are corners[start[g]] .. corners[start[g + 1] - 1],
+	// in index order
+	static void groupCorners(const uint32_t* indices, size_t count, const std::vector<uint32_t>& group, size_t groups,
+		std::vector<uint32_t>& start, std::vector<uint32_t>& corners) {
+		start.assign(groups + 1, 0);
+		for (size_t i = 0; i < count; i++) {
+			start[group[indices[i]] + 1]++;
+		}
+		for (size_t g = 0; g < groups; g++) {
+			start[g + 1] += start[g];
+		}
+		std::vector<uint32_t> next(start.begin(), start.end() - 1);
+		corners.resize(count);
+		for (size_t i = 0; i < count; i++) {
+			corners[next[group[indices[i]]]++] = static_cast<uint32_t>(i);
+		}
+	}
+
+	// body(begin, end) over [0, count) in blocks of BLOCK_SIZE, spread over the shared pool
+	static void forEachBlock(size_t count, const std::function<void(size_t, size_t)>& body) {
+		size_t blocks = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		if (blocks <= 1) {
+			body(0, count);
+			return;
+		}
+		ThreadPool::shared().parallelFor(blocks, [&](size_t b) {
+			body(b * BLOCK_SIZE, std::min(count, (b + 1) * BLOCK_SIZE));
+		});
+	}
+};
+#endif
@@ -0,0 +1,261 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vertex.h"
+
+// Post transform cache statistics of an index buffer
+struct VertexCacheStats {
+	size_t transformed = 0;		// vertex shader invocations of a FIFO cache
+	float acmr = 0.0f;			// average cache miss ratio: transformed vertices per triangle, 0.5 is the ideal
+	float atvr = 0.0f;			// average transformed vertex ratio: transformed per referenced vertex, 1.0 is the ideal
+};
+
+// Reorders index and vertex buffers without changing what is drawn:
+// triangles for the post transform vertex cache (Tipsify, Sander et al. 2007), clusters of them against overdraw,
+// and vertices in the order they are first fetched
+class MeshOptimizer
+{
+public:
+	static const unsigned CACHE_SIZE = 16;		// FIFO entries assumed for optimizing and reporting
+
+	// Optimizes every level of detail in place, each one is its own index range. Then renumbers the vertices for fetch
+	// locality, which keeps the ranges valid since all levels share the vertex buffer
+	static void optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<std::pair<uint32_t, uint32_t>>& ranges) {
+		for (const std::pair<uint32_t, uint32_t>& range : ranges) {
+			std::vector<uint32_t> clusters;
+			optimizeVertexCache(indices.data() + range.first, range.second, vertices.size(), clusters);
+			optimizeOverdraw(indices.data() + range.first, range.second, vertices, clusters);
+		}
+		optimizeVertexFetch(vertices, indices);
+	}
+
+	// Tipsify: fans around the current vertex, then continues with the vertex that is still in the cache and
+	// will stay there the longest. clusters receives the first triangle of every run that starts with a cold cache
+	static void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>& clusters) {
+		size_t triangleCount = indexCount / 3;
+		clusters.clear();
+		if (triangleCount == 0) {
+			return;
+		}
+
+		std::vector<uint32_t> live(vertexCount, 0), offsets(vertexCount + 1, 0), adjacency(triangleCount * 3);
+		for (size_t i = 0; i < triangleCount * 3; i++) {
+			live[indices[i]]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++) {
+			offsets[v + 1] = offsets[v] + live[v];
+		}
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++) {
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		std::vector<uint32_t> result;
+		result.reserve(triangleCount * 3);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> timestamps(vertexCount, 0);
+		std::vector<uint32_t> deadEnd, candidates;
+		uint32_t time = CACHE_SIZE + 1;
+		size_t cursor = 0;
+
+		bool cold = true;
+		int64_t fan = skipDeadEnd(deadEnd, live, cursor, cold);
+		while (fan >= 0) {
+			if (cold) {
+				clusters.push_back(static_cast<uint32_t>(result.size() / 3));
+			}
+			candidates.clear();
+			for (uint32_t k = offsets[fan]; k < offsets[fan + 1]; k++) {
+				uint32_t t = adjacency[k];
+				if (emitted[t]) {
+					continue;
+				}
+				emitted[t] = true;
+				for (int corner = 0; corner < 3; corner++) {
+					uint32_t v = indices[t * 3 + corner];
+					result.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					live[v]--;
+					if (time - timestamps[v] > CACHE_SIZE) {
+						timestamps[v] = time++;
+					}
+				}
+			}
+
+			// the candidate that stays cached longest, unless its remaining triangles would push it out first
+			fan = -1;
+			int64_t best = -1;
+			for (uint32_t v : candidates) {
+				if (live[v] == 0) {
+					continue;
+				}
+				int64_t priority = 0;
+				if (time - timestamps[v] + 2 * live[v] <= CACHE_SIZE) {
+					priority = time - timestamps[v];
+				}
+				if (priority > best) {
+					best = priority;
+					fan = v;
+				}
+			}
+			cold = false;
+			if (fan < 0) {
+				fan = skipDeadEnd(deadEnd, live, cursor, cold);
+			}
+		}
+		std::copy(result.begin(), result.end(), indices);
+	}
+
+	// Draws the clusters facing away from the mesh center first, so that outer surfaces tend to be drawn before
+	// what they hide (Sander et al. 2007, as done in meshoptimizer). Kept only if the cache stays within 5%
+	static void optimizeOverdraw(uint32_t* indices, size_t indexCount, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& hardClusters, float threshold = 1.05f) {
+		size_t triangleCount = indexCount / 3;
+		std::vector<uint32_t> clusters = softBoundaries(indices, triangleCount, vertices.size(), hardClusters, threshold);
+		if (clusters.size() < 2) {
+			return;
+		}
+
+		glm::vec3 meshCenter(0.0f);
+		float meshArea = 0.0f;
+		struct Cluster {
+			uint32_t first, count;
+			float sortKey;
+		};
+		std::vector<Cluster> order(clusters.size());
+		std::vector<glm::vec3> centers(clusters.size()), normals(clusters.size());
+		for (size_t c = 0; c < clusters.size(); c++) {
+			uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32_t>(triangleCount);
+			glm::vec3 center(0.0f), normal(0.0f);
+			float area = 0.0f;
+			for (uint32_t t = clusters[c]; t < end; t++) {
+				glm::vec3 a = vertices[indices[t * 3]].Position, b = vertices[indices[t * 3 + 1]].Position, d = vertices[indices[t * 3 + 2]].Position;
+				glm::vec3 cross = glm::cross(b - a, d - a);
+				float triangleArea = glm::length(cross);
+				center += (a + b + d) * (triangleArea / 3.0f);
+				normal += cross;
+				area += triangleArea;
+			}
+			meshCenter += center;
+			meshArea += area;
+			centers[c] = area > 0.0f ? center / area : center;
+			normals[c] = glm::length(normal) > 0.0f ? glm::normalize(normal) : normal;
+			order[c] = Cluster{ clusters[c], end - clusters[c], 0.0f };
+		}
+		if (meshArea > 0.0f) {
+			meshCenter /= meshArea;
+		}
+		for (size_t c = 0; c < clusters.size(); c++) {
+			order[c].sortKey = glm::dot(centers[c] - meshCenter, normals[c]);
+		}
+		std::stable_sort(order.begin(), order.end(), [](const Cluster& x, const Cluster& y) { return x.sortKey > y.sortKey; });
+
+		std::vector<uint32_t> sorted;
+		sorted.reserve(triangleCount * 3);
+		for (const Cluster& cluster : order) {
+			sorted.insert(sorted.end(), indices + cluster.first * 3, indices + (cluster.first + cluster.count) * 3);
+		}
+		size_t vertexCount = vertices.size();
+		if (analyze(sorted.data(), sorted.size(), vertexCount).transformed <= threshold * analyze(indices, triangleCount * 3, vertexCount).transformed) {
+			std::copy(sorted.begin(), sorted.end(), indices);
+		}
+	}
+
+	// Renumbers vertices in order of first use. Vertices no index refers to are dropped
+	static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+		const uint32_t unassigned = 0xffffffffu;
+		std::vector<uint32_t> remap(vertices.size(), unassigned);
+		std::vector<Vertex> reordered;
+		reordered.reserve(vertices.size());
+		for (uint32_t& index : indices) {
+			if (remap[index] == unassigned) {
+				remap[index] = static_cast<uint32_t>(reordered.size());
+				reordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(reordered);
+	}
+
+	// simulates a FIFO post transform cache of cacheSize entries
+	static VertexCacheStats analyze(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = CACHE_SIZE) {
+		VertexCacheStats stats;
+		std::vector<uint32_t> cachedAt(vertexCount, 0);		// miss counter value when the vertex entered the cache, 0 if never
+		std::vector<bool> referenced(vertexCount, false);
+		size_t unique = 0;
+		for (size_t i = 0; i < indexCount; i++) {
+			uint32_t v = indices[i];
+			if (cachedAt[v] == 0 || stats.transformed + 1 - cachedAt[v] > cacheSize) {
+				stats.transformed++;
+				cachedAt[v] = static_cast<uint32_t>(stats.transformed);
+			}
+			if (!referenced[v]) {
+				referenced[v] = true;
+				unique++;
+			}
+		}
+		if (indexCount >= 3) {
+			stats.acmr = float(stats.transformed) / float(indexCount / 3);
+		}
+		if (unique > 0) {
+			stats.atvr = float(stats.transformed) / float(unique);
+		}
+		return stats;
+	}
+
+private:
+	// Splits the clusters further wherever the triangles so far already reach the cache efficiency of the whole
+	// cluster, restarting from a cold cache there costs little
+	static std::vector<uint32_t> softBoundaries(const uint32_t* indices, size_t triangleCount, size_t vertexCount, const std::vector<uint32_t>& hardClusters, float threshold) {
+		std::vector<uint32_t> clusters;
+		std::vector<uint32_t> cachedAt(vertexCount, 0);
+		uint32_t misses = 0;
+		for (size_t c = 0; c < hardClusters.size(); c++) {
+			uint32_t first = hardClusters[c];
+			uint32_t end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : static_cast<uint32_t>(triangleCount);
+			float clusterAcmr = analyze(indices + first * 3, (end - first) * 3, vertexCount).acmr;
+
+			uint32_t start = first, startMisses = misses;
+			clusters.push_back(start);
+			for (uint32_t t = first; t < end; t++) {
+				for (int corner = 0; corner < 3; corner++) {
+					uint32_t v = indices[t * 3 + corner];
+					if (cachedAt[v] <= startMisses || misses + 1 - cachedAt[v] > CACHE_SIZE) {
+						cachedAt[v] = ++misses;
+					}
+				}
+				if (t + 1 < end && float(misses - startMisses) / float(t + 1 - start) <= threshold * clusterAcmr) {
+					start = t + 1;
+					startMisses = misses;		// everything before counts as evicted
+					clusters.push_back(start);
+				}
+			}
+		}
+		return clusters;
+	}
+
+	// next vertex with triangles left: the most recently used one from the dead end stack, else the next one in index order
+	static int64_t skipDeadEnd(std::vector<uint32_t>& deadEnd, const std::vector<uint32_t>& live, size_t& cursor, bool& cold) {
+		while (!deadEnd.empty()) {
+			uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[v] > 0) {
+				return v;
+			}
+		}
+		cold = true;
+		for (; cursor < live.size(); cursor++) {
+			if (live[cursor] > 0) {
+				return static_cast<int64_t>(cursor++);
+			}
+		}
+		return -1;
+	}
+};
+#endif
@@ -0,0 +1,51 @@
+#ifndef MESH_REGISTRY_H
+#define MESH_REGISTRY_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "mesh.h"
+
+// Loads every .obj path once and hands out shared handles to the resulting Mesh.
+// The registry only keeps weak references: a mesh is freed when its last handle is dropped
+// and loaded again if it is acquired after that
+class MeshRegistry
+{
+public:
+	std::shared_ptr<Mesh> acquire(const std::string& path) {
+		std::weak_ptr<Mesh>& entry = meshes[path];
+		std::shared_ptr<Mesh> mesh = entry.lock();
+		if (!mesh) {
+			mesh = std::make_shared<Mesh>(path.c_str());
+			entry = mesh;
+		}
+		return mesh;
+	}
+
+	// Like acquire, but a mesh that is not in the registry yet is created empty and created is set,
+	// the caller then loads it (see AssetLoader::loadMesh)
+	std::shared_ptr<Mesh> acquireDeferred(const std::string& path, bool& created) {
+		std::weak_ptr<Mesh>& entry = meshes[path];
+		std::shared_ptr<Mesh> mesh = entry.lock();
+		created = !mesh;
+		if (created) {
+			mesh = std::make_shared<Mesh>();
+			entry = mesh;
+		}
+		return mesh;
+	}
+
+	// number of meshes that are still referenced somewhere
+	size_t size() const {
+		size_t alive = 0;
+		for (const auto& entry : meshes) {
+			alive += entry.second.expired() ? 0 : 1;
+		}
+		return alive;
+	}
+
+private:
+	std::unordered_map<std::string, std::weak_ptr<Mesh>> meshes;
+};
+#endif
@@ -0,0 +1,355 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vertex.h"
+
+// One level of detail: a range of the mesh index buffer and the geometric error (object space) it introduces
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+	uint32_t reserved;
+};
+
+static_assert(sizeof(MeshLod) == 16, "MeshLod is stored as is in the .vrmesh cache");
+
+// The triangles of one material within one level of detail
+struct MeshSubmesh {
+	uint32_t lod;
+	uint32_t material;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+static_assert(sizeof(MeshSubmesh) == 16, "MeshSubmesh is stored as is in the .vrmesh cache");
+
+// Quadric error metric simplification by edge collapse (Garland & Heckbert).
+// Vertices are only ever collapsed onto other existing vertices, so every level keeps using the original vertex
+// buffer and only needs its own index range. Vertices on open borders and on uv/normal seams are never removed
+class MeshSimplifier
+{
+public:
+	// Builds the chain: level 0 is indices itself, each further level aims at half the triangles of the previous one.
+	// The levels are appended to indices. Stops early when a level would not get meaningfully smaller
+	static std::vector<MeshLod> buildLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, int maxLevels = 4) {
+		std::vector<MeshLod> lods;
+		MeshLod full = { 0, static_cast<uint32_t>(indices.size()), 0.0f, 0 };
+		lods.push_back(full);
+
+		std::vector<uint32_t> previous(indices);
+		float error = 0.0f;
+		for (int level = 1; level < maxLevels; level++) {
+			float levelError = 0.0f;
+			std::vector<uint32_t> simplified = simplify(vertices, previous, previous.size() / 2, levelError);
+			if (simplified.empty() || simplified.size() > previous.size() * 9 / 10) {
+				break;
+			}
+			error += levelError;		// levels are built from each other, so the bounds add up
+			MeshLod lod = { static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()), error, 0 };
+			lods.push_back(lod);
+			indices.insert(indices.end(), simplified.begin(), simplified.end());
+			previous.swap(simplified);
+		}
+		return lods;
+	}
+
+	// Chain of a mesh with materials: triangleMaterials holds one material per triangle. Every material is simplified
+	// on its own so no triangle changes material, the borders between materials stay where they are.
+	// indices is rewritten level by level, sorted by material within each level, and submeshes lists the pieces.
+	// Without simplify only level 0 is built
+	static std::vector<MeshLod> buildMaterialLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+		const std::vector<uint32_t>& triangleMaterials, bool simplify, std::vector<MeshSubmesh>& submeshes, int maxLevels = 4) {
+		std::vector<std::vector<uint32_t>> groups;
+		for (size_t t = 0; t * 3 + 2 < indices.size(); t++) {
+			uint32_t material = t < triangleMaterials.size() ? triangleMaterials[t] : 0;
+			if (material >= groups.size()) {
+				groups.resize(material + 1);
+			}
+			groups[material].insert(groups[material].end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+		}
+
+		std::vector<std::vector<MeshLod>> groupLods(groups.size());
+		size_t levels = 1;
+		for (size_t g = 0; g < groups.size(); g++) {
+			if (simplify && !groups[g].empty()) {
+				groupLods[g] = buildLods(vertices, groups[g], maxLevels);
+			}
+			else {
+				groupLods[g].push_back(MeshLod{ 0, static_cast<uint32_t>(groups[g].size()), 0.0f, 0 });
+			}
+			levels = std::max(levels, groupLods[g].size());
+		}
+
+		// a material that could not be simplified as far as the others keeps its coarsest level
+		std::vector<MeshLod> lods;
+		indices.clear();
+		submeshes.clear();
+		for (size_t level = 0; level < levels; level++) {
+			MeshLod lod = { static_cast<uint32_t>(indices.size()), 0, 0.0f, 0 };
+			for (size_t g = 0; g < groups.size(); g++) {
+				const MeshLod& source = groupLods[g][std::min(level, groupLods[g].size() - 1)];
+				if (source.indexCount == 0) {
+					continue;
+				}
+				MeshSubmesh submesh = { static_cast<uint32_t>(level), static_cast<uint32_t>(g), static_cast<uint32_t>(indices.size()), source.indexCount };
+				submeshes.push_back(submesh);
+				indices.insert(indices.end(), groups[g].begin() + source.firstIndex, groups[g].begin() + source.firstIndex + source.indexCount);
+				lod.error = std::max(lod.error, source.error);
+			}
+			lod.indexCount = static_cast<uint32_t>(indices.size()) - lod.firstIndex;
+			lods.push_back(lod);
+		}
+		return lods;
+	}
+
+	// Collapses edges in order of increasing quadric error until at most targetIndexCount indices are left
+	// or nothing can be collapsed anymore. error receives an upper bound of the distance any vertex moved off
+	// the original surface
+	static std::vector<uint32_t> simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& source, size_t targetIndexCount, float& error) {
+		error = 0.0f;
+		size_t numVertices = vertices.size();
+		std::vector<uint32_t> indices(source);
+
+		std::vector<uint32_t> positionOf = positionRemap(vertices);
+		std::vector<bool> locked = lockedVertices(vertices, indices, positionOf);
+
+		std::vector<Quadric> quadrics(numVertices);
+		for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+			Quadric plane = Quadric::fromTriangle(vertices[indices[t]].Position, vertices[indices[t + 1]].Position, vertices[indices[t + 2]].Position);
+			for (int k = 0; k < 3; k++) {
+				quadrics[positionOf[indices[t + k]]].add(plane);
+			}
+		}
+
+		std::vector<uint32_t> collapseTo(numVertices);
+		std::vector<bool> touched(numVertices);
+		std::vector<uint32_t> triangleOffsets, triangleList;
+
+		for (int pass = 0; pass < 64 && indices.size() > targetIndexCount; pass++) {
+			buildAdjacency(indices, numVertices, triangleOffsets, triangleList);
+
+			// candidate collapses a -> b along every triangle edge
+			std::vector<Collapse> candidates;
+			candidates.reserve(indices.size() * 2);
+			for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+				for (int k = 0; k < 3; k++) {
+					uint32_t a = indices[t + k];
+					uint32_t b = indices[t + (k + 1) % 3];
+					for (int direction = 0; direction < 2; direction++) {
+						if (!locked[a]) {
+							Quadric q = quadrics[positionOf[a]];
+							q.add(quadrics[positionOf[b]]);
+							Collapse c = { a, b, static_cast<float>(q.evaluate(vertices[b].Position)) };
+							candidates.push_back(c);
+						}
+						std::swap(a, b);
+					}
+				}
+			}
+			if (candidates.empty()) {
+				break;
+			}
+			std::sort(candidates.begin(), candidates.end(), [](const Collapse& x, const Collapse& y) {
+				return x.cost < y.cost || (x.cost == y.cost && (x.from < y.from || (x.from == y.from && x.to < y.to)));
+			});
+
+			for (size_t v = 0; v < numVertices; v++) {
+				collapseTo[v] = static_cast<uint32_t>(v);
+			}
+			std::fill(touched.begin(), touched.end(), false);
+
+			// every collapse of an interior vertex removes about two triangles
+			size_t triangles = indices.size() / 3;
+			size_t targetTriangles = targetIndexCount / 3;
+			size_t collapsed = 0;
+			for (const Collapse& c : candidates) {
+				if (triangles <= targetTriangles) {
+					break;
+				}
+				if (touched[c.from] || touched[c.to] || !keepsOrientation(vertices, indices, triangleOffsets, triangleList, c.from, c.to)) {
+					continue;
+				}
+				collapseTo[c.from] = c.to;
+				quadrics[positionOf[c.to]].add(quadrics[positionOf[c.from]]);
+				error = std::max(error, std::sqrt(std::max(c.cost, 0.0f)));
+				collapsed++;
+				triangles -= std::min<size_t>(triangles, 2);
+
+				// the neighbourhood changed, its remaining candidates are stale until the next pass
+				for (uint32_t i = triangleOffsets[c.from]; i < triangleOffsets[c.from + 1]; i++) {
+					size_t t = triangleList[i];
+					touched[indices[t]] = touched[indices[t + 1]] = touched[indices[t + 2]] = true;
+				}
+			}
+			if (collapsed == 0) {
+				break;
+			}
+
+			size_t written = 0;
+			for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+				uint32_t a = collapseTo[indices[t]], b = collapseTo[indices[t + 1]], c = collapseTo[indices[t + 2]];
+				if (a != b && b != c && a != c) {
+					indices[written++] = a;
+					indices[written++] = b;
+					indices[written++] = c;
+				}
+			}
+			indices.resize(written);
+		}
+		return indices;
+	}
+
+private:
+	struct Collapse {
+		uint32_t from, to;
+		float cost;
+	};
+
+	// symmetric 4x4 matrix of the plane equations, upper triangle only
+	struct Quadric {
+		double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+		static Quadric fromTriangle(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+			Quadric q;
+			glm::dvec3 normal = glm::cross(glm::dvec3(p1) - glm::dvec3(p0), glm::dvec3(p2) - glm::dvec3(p0));
+			double length = glm::length(normal);
+			if (length == 0.0) {
+				return q;
+			}
+			normal /= length;
+			double d = -glm::dot(normal, glm::dvec3(p0));
+			q.a2 = normal.x * normal.x; q.ab = normal.x * normal.y; q.ac = normal.x * normal.z; q.ad = normal.x * d;
+			q.b2 = normal.y * normal.y; q.bc = normal.y * normal.z; q.bd = normal.y * d;
+			q.c2 = normal.z * normal.z; q.cd = normal.z * d;
+			q.d2 = d * d;
+			return q;
+		}
+
+		void add(const Quadric& o) {
+			a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad; b2 += o.b2;
+			bc += o.bc; bd += o.bd; c2 += o.c2; cd += o.cd; d2 += o.d2;
+		}
+
+		// sum of squared distances of p to all accumulated planes
+		double evaluate(const glm::vec3& p) const {
+			double x = p.x, y = p.y, z = p.z;
+			return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+				+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+				+ c2 * z * z + 2 * cd * z + d2;
+		}
+	};
+
+	// index of the first vertex with the same position, shared by the quadrics of uv/normal seam twins
+	static std::vector<uint32_t> positionRemap(const std::vector<Vertex>& vertices) {
+		std::vector<uint32_t> remap(vertices.size());
+		size_t capacity = 16;
+		while (capacity < vertices.size() * 2) {
+			capacity <<= 1;
+		}
+		std::vector<uint32_t> table(capacity, 0xffffffffu);
+		for (size_t v = 0; v < vertices.size(); v++) {
+			uint32_t bits[3];
+			std::memcpy(bits, &vertices[v].Position, sizeof(bits));
+			size_t slot = ((bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u)) & (capacity - 1);
+			while (table[slot] != 0xffffffffu && vertices[table[slot]].Position != vertices[v].Position) {
+				slot = (slot + 1) & (capacity - 1);
+			}
+			if (table[slot] == 0xffffffffu) {
+				table[slot] = static_cast<uint32_t>(v);
+			}
+			remap[v] = table[slot];
+		}
+		return remap;
+	}
+
+	// vertices on seams (another vertex shares the position) or on open borders (an edge used by a single triangle)
+	static std::vector<bool> lockedVertices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionOf) {
+		std::vector<bool> locked(vertices.size(), false);
+		for (size_t v = 0; v < vertices.size(); v++) {
+			if (positionOf[v] != v) {
+				locked[v] = true;
+				locked[positionOf[v]] = true;
+			}
+		}
+
+		// an edge is interior if its reverse shows up as often as itself
+		std::vector<uint64_t> edges;
+		edges.reserve(indices.size());
+		for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+			for (int k = 0; k < 3; k++) {
+				uint64_t a = positionOf[indices[t + k]], b = positionOf[indices[t + (k + 1) % 3]];
+				edges.push_back(a < b ? (a << 32 | b) << 1 : (b << 32 | a) << 1 | 1);
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		std::vector<bool> border(vertices.size(), false);
+		for (size_t i = 0; i < edges.size();) {
+			size_t j = i;
+			int balance = 0;
+			while (j < edges.size() && edges[j] >> 1 == edges[i] >> 1) {
+				balance += (edges[j] & 1) ? -1 : 1;
+				j++;
+			}
+			if (balance != 0) {
+				uint64_t key = edges[i] >> 1;
+				border[static_cast<size_t>(key >> 32)] = true;
+				border[static_cast<size_t>(key & 0xffffffffu)] = true;
+			}
+			i = j;
+		}
+		for (size_t v = 0; v < vertices.size(); v++) {
+			if (border[positionOf[v]]) {
+				locked[v] = true;
+			}
+		}
+		return locked;
+	}
+
+	// triangles around every vertex, as start offsets into triangleList (which holds the triangles' first index)
+	static void buildAdjacency(const std::vector<uint32_t>& indices, size_t numVertices, std::vector<uint32_t>& offsets, std::vector<uint32_t>& list) {
+		offsets.assign(numVertices + 1, 0);
+		for (uint32_t index : indices) {
+			offsets[index + 1]++;
+		}
+		for (size_t v = 0; v < numVertices; v++) {
+			offsets[v + 1] += offsets[v];
+		}
+		list.resize(indices.size());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++) {
+			list[fill[indices[i]]++] = static_cast<uint32_t>(i - i % 3);
+		}
+	}
+
+	// moving from onto to must not flip or squash any triangle around from that survives the collapse
+	static bool keepsOrientation(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+		const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& list, uint32_t from, uint32_t to) {
+		for (uint32_t i = offsets[from]; i < offsets[from + 1]; i++) {
+			size_t t = list[i];
+			uint32_t corner[3] = { indices[t], indices[t + 1], indices[t + 2] };
+			if (corner[0] == to || corner[1] == to || corner[2] == to) {
+				continue;		// this one degenerates and is removed
+			}
+			glm::vec3 before[3], after[3];
+			for (int k = 0; k < 3; k++) {
+				before[k] = vertices[corner[k]].Position;
+				after[k] = corner[k] == from ? vertices[to].Position : before[k];
+			}
+			glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+			if (glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter)) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+#endif
@@ -0,0 +1,109 @@
+#ifndef MTL_PARSER_H
+#define MTL_PARSER_H
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "asset_pack.h"
+#include "obj_parser.h"
+
+// One newmtl block of a .mtl file. Values that are not given keep the defaults below
+struct Material {
+	std::string name;
+	glm::vec3 ambient = glm::vec3(1.0f);		// Ka
+	glm::vec3 diffuse = glm::vec3(0.8f);		// Kd
+	glm::vec3 specular = glm::vec3(0.5f);		// Ks
+	glm::vec3 emission = glm::vec3(0.0f);		// Ke
+	float shininess = 32.0f;					// Ns
+	float opacity = 1.0f;						// d, or 1 - Tr
+	std::string diffuseMap;						// map_Kd, relative to the .mtl
+};
+
+// Wavefront .mtl reader, tokenizes the mapped file in place like ObjParser
+class MtlParser
+{
+public:
+	// appends the materials of the file, returns false if it cannot be opened
+	static bool parseFile(const std::string& path, std::vector<Material>& out) {
+		AssetFile file;
+		if (!file.open(path.c_str()) || file.data() == nullptr) {
+			return false;
+		}
+		parse(file.data(), file.end(), out);
+		return true;
+	}
+
+	static void parse(const char* begin, const char* end, std::vector<Material>& out) {
+		const char* p = begin;
+		Material* current = nullptr;
+		while (p < end) {
+			const char* lineEnd = ObjParser::findLineEnd(p, end);
+			p = ObjParser::skipSpaces(p, lineEnd);
+			if (keyword(p, lineEnd, "newmtl")) {
+				out.push_back(Material());
+				current = &out.back();
+				current->name = ObjParser::restOfLine(p + 6, lineEnd);
+			}
+			else if (current != nullptr) {
+				if (keyword(p, lineEnd, "Ka")) {
+					parseColor(p + 2, lineEnd, current->ambient);
+				}
+				else if (keyword(p, lineEnd, "Kd")) {
+					parseColor(p + 2, lineEnd, current->diffuse);
+				}
+				else if (keyword(p, lineEnd, "Ks")) {
+					parseColor(p + 2, lineEnd, current->specular);
+				}
+				else if (keyword(p, lineEnd, "Ke")) {
+					parseColor(p + 2, lineEnd, current->emission);
+				}
+				else if (keyword(p, lineEnd, "Ns")) {
+					ObjParser::parseFloat(p + 2, lineEnd, current->shininess);
+				}
+				else if (keyword(p, lineEnd, "d")) {
+					ObjParser::parseFloat(p + 1, lineEnd, current->opacity);
+				}
+				else if (keyword(p, lineEnd, "Tr")) {
+					float transparency = 0.0f;
+					ObjParser::parseFloat(p + 2, lineEnd, transparency);
+					current->opacity = 1.0f - transparency;
+				}
+				else if (keyword(p, lineEnd, "map_Kd")) {
+					current->diffuseMap = ObjParser::restOfLine(p + 6, lineEnd);		// options like -bm are not supported
+				}
+			}
+			p = lineEnd + 1;
+		}
+	}
+
+	// the library file next to the .obj that names it
+	static std::string libraryPath(const std::string& objPath, const std::string& library) {
+		size_t slash = objPath.find_last_of("/\\");
+		return slash == std::string::npos ? library : objPath.substr(0, slash + 1) + library;
+	}
+
+private:
+	static bool keyword(const char* p, const char* lineEnd, const char* name) {
+		size_t length = std::strlen(name);
+		return static_cast<size_t>(lineEnd - p) > length && std::memcmp(p, name, length) == 0 &&
+			(p[length] == ' ' || p[length] == '\t');
+	}
+
+	// "r g b", a single value sets all three
+	static void parseColor(const char* p, const char* lineEnd, glm::vec3& color) {
+		const char* next = ObjParser::parseFloat(p, lineEnd, color.r);
+		if (next == p) {
+			return;
+		}
+		const char* g = ObjParser::parseFloat(next, lineEnd, color.g);
+		if (g == next) {
+			color.g = color.b = color.r;
+			return;
+		}
+		ObjParser::parseFloat(g, lineEnd, color.b);
+	}
+};
+#endif
@@ -0,0 +1,500 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "vertex.h"
+
+// The vertices from firstVertex on use materials[material], until the next range starts
+struct ObjMaterialRange {
+	size_t firstVertex;
+	uint32_t material;
+};
+
+// Everything read from an .obj file: the raw v/vt/vn records, the expanded triangle vertices and the materials
+struct ObjData {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> textures;
+	std::vector<glm::vec3> normals;
+	std::vector<Vertex> vertices;
+	std::vector<std::string> materialLibraries;		// mtllib files as written, relative to the .obj
+	std::vector<std::string> materials;				// usemtl names in order of first use
+	std::vector<ObjMaterialRange> materialRanges;	// ascending, vertices before the first range have no material
+};
+
+// One face corner as written in the file. Absolute obj indices (1-based) are stored 0-based, negative ones
+// relative to the records the chunk had read so far: they only become absolute once the chunk offsets are known.
+// A missing index (0) is stored as MISSING: a corner without a position is rejected by .at(), one without uv or normal
+// (v, v/vt and v//vn) gets zeros, Mesh fills in the normals later
+struct ObjCorner {
+	static const uint8_t RELATIVE_POSITION = 1;
+	static const uint8_t RELATIVE_TEXTURE = 2;
+	static const uint8_t RELATIVE_NORMAL = 4;
+	static const int64_t MISSING = -1;
+
+	int64_t position, texture, normal;
+	uint8_t relative;
+
+	static int64_t encode(long index, size_t count, uint8_t flag, uint8_t& relative) {
+		if (index < 0) {
+			relative |= flag;
+			return static_cast<int64_t>(count) + index;
+		}
+		return static_cast<int64_t>(index) - 1;
+	}
+
+	size_t resolve(int64_t index, uint8_t flag, size_t base) const {
+		return static_cast<size_t>((relative & flag) ? static_cast<int64_t>(base) + index : index);
+	}
+
+	bool missing(int64_t index, uint8_t flag) const {
+		return index == MISSING && !(relative & flag);
+	}
+};
+
+// Records of one newline aligned piece of the file
+struct ObjChunk {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> textures;
+	std::vector<glm::vec3> normals;
+	std::vector<ObjCorner> corners;		// three per triangle
+	std::vector<std::string> materialLibraries;
+	std::vector<std::pair<size_t, std::string>> materialSwitches;		// usemtl name and the corner it applies from
+};
+
+// Where the records of a chunk start in the merged arrays
+struct ObjChunkBase {
+	size_t positions = 0, textures = 0, normals = 0, vertices = 0;
+};
+
+// Wavefront .obj reader that tokenizes the memory mapped file in place.
+// No line is ever copied into a std::string or stream, numbers are converted straight from the mapped bytes
+class ObjParser
+{
+public:
+	// returns false if the file cannot be opened
+	static bool parseFile(const char* path, ObjData& out) {
+		MappedFile file;
+		if (!file.open(path)) {
+			return false;
+		}
+		parse(file.data(), file.end(), out);
+		return true;
+	}
+
+	// files smaller than this are parsed on the calling thread only
+	static const size_t PARALLEL_THRESHOLD = 1 << 20;
+
+	// Splits the file into newline aligned chunks that are parsed concurrently, then merges them in file order.
+	// threads = 0 picks the chunk count from the file size and the shared pool; the result does not depend on it
+	static void parse(const char* begin, const char* end, ObjData& out, unsigned threads = 0) {
+		if (threads == 0) {
+			threads = static_cast<size_t>(end - begin) < PARALLEL_THRESHOLD ? 1 : ThreadPool::shared().size() + 1;
+		}
+		std::vector<const char*> bounds = splitLines(begin, end, threads);
+		size_t numChunks = bounds.size() - 1;
+
+		std::vector<ObjChunk> chunks(numChunks);
+		forEachChunk(numChunks, [&](size_t c) {
+			parseRecords(bounds[c], bounds[c + 1], chunks[c]);
+		});
+
+		// prefix sums give every chunk the offset of its first record in the merged arrays
+		std::vector<ObjChunkBase> bases(numChunks);
+		ObjChunkBase total;
+		total.positions = out.positions.size();
+		total.textures = out.textures.size();
+		total.normals = out.normals.size();
+		total.vertices = out.vertices.size();
+		for (size_t c = 0; c < numChunks; c++) {
+			bases[c] = total;
+			total.positions += chunks[c].positions.size();
+			total.textures += chunks[c].textures.size();
+			total.normals += chunks[c].normals.size();
+			total.vertices += chunks[c].corners.size();
+		}
+		out.positions.resize(total.positions);
+		out.textures.resize(total.textures);
+		out.normals.resize(total.normals);
+		out.vertices.resize(total.vertices);
+		mergeMaterials(chunks, bases, out);
+
+		forEachChunk(numChunks, [&](size_t c) {
+			std::copy(chunks[c].positions.begin(), chunks[c].positions.end(), out.positions.begin() + bases[c].positions);
+			std::copy(chunks[c].textures.begin(), chunks[c].textures.end(), out.textures.begin() + bases[c].textures);
+			std::copy(chunks[c].normals.begin(), chunks[c].normals.end(), out.normals.begin() + bases[c].normals);
+		});
+
+		// faces may reference records of any earlier chunk, so corners are resolved once all records are in place
+		forEachChunk(numChunks, [&](size_t c) {
+			const ObjChunkBase& base = bases[c];
+			Vertex* vertex = out.vertices.data() + base.vertices;
+			for (const ObjCorner& corner : chunks[c].corners) {
+				vertex->Position = out.positions.at(corner.resolve(corner.position, ObjCorner::RELATIVE_POSITION, base.positions));
+				vertex->Texture = corner.missing(corner.texture, ObjCorner::RELATIVE_TEXTURE) ? glm::vec2(0.0f)
+					: out.textures.at(corner.resolve(corner.texture, ObjCorner::RELATIVE_TEXTURE, base.textures));
+				vertex->Normal = corner.missing(corner.normal, ObjCorner::RELATIVE_NORMAL) ? glm::vec3(0.0f)
+					: out.normals.at(corner.resolve(corner.normal, ObjCorner::RELATIVE_NORMAL, base.normals));
+				vertex++;
+			}
+		});
+	}
+
+	// Material of every triangle: 0 for none, otherwise 1 + its index in data.materials
+	static std::vector<uint32_t> triangleMaterials(const ObjData& data) {
+		std::vector<uint32_t> materials(data.vertices.size() / 3, 0);
+		for (size_t r = 0; r < data.materialRanges.size(); r++) {
+			size_t first = data.materialRanges[r].firstVertex / 3;
+			size_t end = r + 1 < data.materialRanges.size() ? data.materialRanges[r + 1].firstVertex / 3 : materials.size();
+			std::fill(materials.begin() + std::min(first, materials.size()), materials.begin() + std::min(end, materials.size()), data.materialRanges[r].material + 1);
+		}
+		return materials;
+	}
+
+	// Converts the number starting at p (after optional blanks) and returns the position after it.
+	// Mantissas up to 2^53 with small exponents give the correctly rounded double, which rounds to the same float as
+	// strtof unless it landed exactly halfway between two floats; those, and anything longer, go through strtof on a
+	// small stack copy
+	static const char* parseFloat(const char* p, const char* end, float& out) {
+		p = skipSpaces(p, end);
+		const char* start = p;
+
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			++p;
+		}
+
+		uint64_t mantissa = 0;
+		int significant = 0;
+		int exponent = 0;
+		bool anyDigit = false;
+		while (p < end && isDigit(*p)) {
+			if (significant < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				significant += mantissa != 0;
+			}
+			else {
+				exponent++;
+			}
+			anyDigit = true;
+			++p;
+		}
+		if (p < end && *p == '.') {
+			++p;
+			while (p < end && isDigit(*p)) {
+				if (significant < 19) {
+					mantissa = mantissa * 10 + (*p - '0');
+					significant += mantissa != 0;
+					exponent--;
+				}
+				anyDigit = true;
+				++p;
+			}
+		}
+		if (!anyDigit) {
+			out = 0.0f;
+			return start;
+		}
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			const char* e = p + 1;
+			bool negativeExponent = false;
+			if (e < end && (*e == '-' || *e == '+')) {
+				negativeExponent = *e == '-';
+				++e;
+			}
+			if (e < end && isDigit(*e)) {
+				int value = 0;
+				while (e < end && isDigit(*e)) {
+					if (value < 10000) {
+						value = value * 10 + (*e - '0');
+					}
+					++e;
+				}
+				exponent += negativeExponent ? -value : value;
+				p = e;
+			}
+		}
+
+		static const double powersOfTen[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+		if (mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+			double value = exponent < 0 ? double(mantissa) / powersOfTen[-exponent] : double(mantissa) * powersOfTen[exponent];
+			float rounded = static_cast<float>(value);
+			if (double(rounded) == value || !isFloatMidpoint(value, rounded)) {
+				out = negative ? -rounded : rounded;
+				return p;
+			}
+		}
+		char buffer[128];
+		size_t length = static_cast<size_t>(p - start);
+		if (length >= sizeof(buffer)) {
+			length = sizeof(buffer) - 1;
+		}
+		std::memcpy(buffer, start, length);
+		buffer[length] = '\0';
+		out = std::strtof(buffer, nullptr);
+		return p;
+	}
+
+	// signed decimal integer, returns start if there is no digit
+	static const char* parseInt(const char* p, const char* end, long& out) {
+		const char* start = p;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			++p;
+		}
+		if (p >= end || !isDigit(*p)) {
+			out = 0;
+			return start;
+		}
+		long value = 0;
+		while (p < end && isDigit(*p)) {
+			value = value * 10 + (*p - '0');
+			++p;
+		}
+		out = negative ? -value : value;
+		return p;
+	}
+
+	static const char* findLineEnd(const char* p, const char* end) {
+		const char* newline = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+		return newline != nullptr ? newline : end;
+	}
+
+	static const char* skipSpaces(const char* p, const char* end) {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+			++p;
+		}
+		return p;
+	}
+
+	// the rest of the line without surrounding blanks, e.g. a material name
+	static std::string restOfLine(const char* p, const char* lineEnd) {
+		p = skipSpaces(p, lineEnd);
+		const char* last = lineEnd;
+		while (last > p && isSpace(last[-1])) {
+			--last;
+		}
+		return std::string(p, last);
+	}
+
+private:
+	static bool isDigit(char c) {
+		return c >= '0' && c <= '9';
+	}
+
+	static bool isSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	// Whether value lies exactly halfway between rounded and the float next to it on value's side. Rounding the exact
+	// decimal to double may have moved it there, so rounding on to float would round twice
+	static bool isFloatMidpoint(double value, float rounded) {
+		float neighbour = std::nextafter(rounded, value > double(rounded) ? float(INFINITY) : -float(INFINITY));
+		return std::isfinite(neighbour) && (double(rounded) + double(neighbour)) * 0.5 == value;
+	}
+
+	// true if the line starts with a keyword of the given length followed by a blank
+	static bool isKeyword(const char* p, const char* lineEnd, int length) {
+		return p + length < lineEnd && isSpace(p[length]);
+	}
+
+	static bool isKeyword(const char* p, const char* lineEnd, const char* keyword) {
+		int length = static_cast<int>(std::strlen(keyword));
+		return lineEnd - p > length && std::memcmp(p, keyword, length) == 0 && isSpace(p[length]);
+	}
+
+	// material names and switches of all chunks in file order, the switch offsets become global vertex indices
+	static void mergeMaterials(const std::vector<ObjChunk>& chunks, const std::vector<ObjChunkBase>& bases, ObjData& out) {
+		for (size_t c = 0; c < chunks.size(); c++) {
+			for (const std::string& library : chunks[c].materialLibraries) {
+				if (std::find(out.materialLibraries.begin(), out.materialLibraries.end(), library) == out.materialLibraries.end()) {
+					out.materialLibraries.push_back(library);
+				}
+			}
+			for (const std::pair<size_t, std::string>& change : chunks[c].materialSwitches) {
+				uint32_t material = static_cast<uint32_t>(std::find(out.materials.begin(), out.materials.end(), change.second) - out.materials.begin());
+				if (material == out.materials.size()) {
+					out.materials.push_back(change.second);
+				}
+				ObjMaterialRange range = { bases[c].vertices + change.first, material };
+				std::vector<ObjMaterialRange>& ranges = out.materialRanges;
+				if (!ranges.empty() && ranges.back().firstVertex == range.firstVertex) {
+					ranges.pop_back();		// no face in between, the earlier usemtl has no effect
+				}
+				if (ranges.empty() || ranges.back().material != range.material) {
+					ranges.push_back(range);
+				}
+			}
+		}
+	}
+
+	// one face corner: p, p/t, p//n or p/t/n
+	static const char* parseCorner(const char* p, const char* end, long& position, long& texture, long& normal) {
+		texture = 0;
+		normal = 0;
+		p = parseInt(p, end, position);
+		if (p < end && *p == '/') {
+			p = parseInt(p + 1, end, texture);
+			if (p < end && *p == '/') {
+				p = parseInt(p + 1, end, normal);
+			}
+		}
+		return p;
+	}
+
+	// Newline aligned [bounds[i], bounds[i + 1]) ranges, at most count of them
+	static std::vector<const char*> splitLines(const char* begin, const char* end, unsigned count) {
+		std::vector<const char*> bounds(1, begin);
+		size_t size = static_cast<size_t>(end - begin);
+		for (unsigned i = 1; i < count; i++) {
+			const char* p = begin + size / count * i;
+			if (p <= bounds.back()) {
+				continue;
+			}
+			p = findLineEnd(p, end);
+			if (p + 1 < end) {
+				bounds.push_back(p + 1);
+			}
+		}
+		bounds.push_back(end);
+		return bounds;
+	}
+
+	template <typename Body>
+	static void forEachChunk(size_t count, Body body) {
+		if (count == 1) {
+			body(0);
+		}
+		else {
+			ThreadPool::shared().parallelFor(count, body);
+		}
+	}
+
+	static void parseRecords(const char* begin, const char* end, ObjChunk& chunk) {
+		reserve(begin, end, chunk);
+
+		const char* p = begin;
+		while (p < end) {
+			const char* lineEnd = findLineEnd(p, end);
+			p = skipSpaces(p, lineEnd);
+			if (p < lineEnd) {
+				if (p[0] == 'v') {
+					if (isKeyword(p, lineEnd, 1)) {		// v x y z
+						glm::vec3 v(0.0f);
+						p = parseFloat(p + 1, lineEnd, v.x);
+						p = parseFloat(p, lineEnd, v.y);
+						parseFloat(p, lineEnd, v.z);
+						chunk.positions.push_back(v);
+					}
+					else if (isKeyword(p, lineEnd, "vt")) {		// vt u v
+						glm::vec2 t(0.0f);
+						p = parseFloat(p + 2, lineEnd, t.x);
+						parseFloat(p, lineEnd, t.y);
+						chunk.textures.push_back(t);
+					}
+					else if (isKeyword(p, lineEnd, "vn")) {		// vn x y z
+						glm::vec3 n(0.0f);
+						p = parseFloat(p + 2, lineEnd, n.x);
+						p = parseFloat(p, lineEnd, n.y);
+						parseFloat(p, lineEnd, n.z);
+						chunk.normals.push_back(n);
+					}
+				}
+				else if (p[0] == 'f' && isKeyword(p, lineEnd, 1)) {
+					parseFace(p + 1, lineEnd, chunk);
+				}
+				else if (p[0] == 'u' && isKeyword(p, lineEnd, "usemtl")) {
+					chunk.materialSwitches.push_back(std::make_pair(chunk.corners.size(), restOfLine(p + 6, lineEnd)));
+				}
+				else if (p[0] == 'm' && isKeyword(p, lineEnd, "mtllib")) {		// one or more file names
+					const char* name = skipSpaces(p + 6, lineEnd);
+					while (name < lineEnd) {
+						const char* nameEnd = name;
+						while (nameEnd < lineEnd && !isSpace(*nameEnd)) {
+							++nameEnd;
+						}
+						chunk.materialLibraries.push_back(std::string(name, nameEnd));
+						name = skipSpaces(nameEnd, lineEnd);
+					}
+				}
+			}
+			p = lineEnd + 1;
+		}
+	}
+
+	// polygons with more than three corners are split into a triangle fan
+	static void parseFace(const char* p, const char* end, ObjChunk& chunk) {
+		ObjCorner first, previous;
+		int corners = 0;
+		while (true) {
+			p = skipSpaces(p, end);
+			if (p >= end || *p == '#') {
+				break;
+			}
+			long pi, ti, ni;
+			const char* next = parseCorner(p, end, pi, ti, ni);
+			if (next == p) {
+				break;		// not a corner, ignore the rest of the line
+			}
+			p = next;
+
+			ObjCorner corner;
+			corner.relative = 0;
+			corner.position = ObjCorner::encode(pi, chunk.positions.size(), ObjCorner::RELATIVE_POSITION, corner.relative);
+			corner.texture = ObjCorner::encode(ti, chunk.textures.size(), ObjCorner::RELATIVE_TEXTURE, corner.relative);
+			corner.normal = ObjCorner::encode(ni, chunk.normals.size(), ObjCorner::RELATIVE_NORMAL, corner.relative);
+
+			if (corners >= 2) {
+				chunk.corners.push_back(first);
+				chunk.corners.push_back(previous);
+				chunk.corners.push_back(corner);
+			}
+			else if (corners == 0) {
+				first = corner;
+			}
+			previous = corner;
+			corners++;
+		}
+	}
+
+	// count the records up front so the vectors are allocated exactly once
+	static void reserve(const char* begin, const char* end, ObjChunk& chunk) {
+		size_t numPositions = 0, numTextures = 0, numNormals = 0, numFaces = 0;
+		const char* p = begin;
+		while (p < end) {
+			const char* lineEnd = findLineEnd(p, end);
+			if (lineEnd - p >= 2) {
+				if (p[0] == 'v') {
+					if (isKeyword(p, lineEnd, 1)) numPositions++;
+					else if (isKeyword(p, lineEnd, "vt")) numTextures++;
+					else if (isKeyword(p, lineEnd, "vn")) numNormals++;
+				}
+				else if (p[0] == 'f' && isSpace(p[1])) {
+					numFaces++;
+				}
+			}
+			p = lineEnd + 1;
+		}
+		chunk.positions.reserve(numPositions);
+		chunk.textures.reserve(numTextures);
+		chunk.normals.reserve(numNormals);
+		chunk.corners.reserve(3 * numFaces);
+	}
+};
+#endif
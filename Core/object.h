@@ -2,11 +2,8 @@
 #define OBJECT_H
 
 #include<iostream>
-#include <fstream>
+#include <memory>
 #include <string>
-#include <sstream>
-#include <vector>
-
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -14,28 +11,19 @@
 #include <glm/glm.hpp>
 #include<glm/gtc/matrix_transform.hpp>
 
-struct Vertex {
-	glm::vec3 Position;
-	glm::vec2 Texture;
-	glm::vec3 Normal;
-};
+#include "mesh.h"
 
 
+// One placed instance of a mesh: the geometry is shared through the handle, everything else is per piece
 class Object
 {
 public:
-	std::vector<glm::vec3> positions;
-	std::vector<glm::vec2> textures;
-	std::vector<glm::vec3> normals;
-	std::vector<Vertex> vertices;
-
-	int numVertices;
-
-	GLuint VBO, VAO;
+	std::shared_ptr<Mesh> mesh;
 
 	glm::mat4 model = glm::mat4(1.0);
 
 	float selected = 0.0;
+	float textureLayer = 0.0;		// layer of the texture array the piece is drawn with
 	std::string color;
 
 	glm::vec3 position;
@@ -45,181 +33,84 @@ public:
 
 	Object(glm::vec3 Position) : position(Position){}		// to set a new position in main: objectxy.posiiton = glm::vec3(xpos,ypos,zpos);
 
-
-	Object(const char* path) {
-
-		// Read the file defined by the path argument 
-		// open the .obj file into a text editor and see how the data are organized
-		// you will see line starting by v, vt, vn and f --> what are these ?
-		// Then parse it to extract the data you need
-		// keep track of the number of vertices you need
-
-		// read file line by line
-		std::ifstream infile(path);
-		std::string line;
-		while (std::getline(infile, line))
-		{
-			std::istringstream iss(line);
-			std::string indice;
-			iss >> indice;
-			//std::cout << "indice : " << indice << std::endl;
-			if (indice == "v") {		// order the file depending on the letters the lines start with
-				float x, y, z;			// for a vertex (i.e. a point of a triangle) you get the x, y and z position
-				iss >> x >> y >> z;
-				positions.push_back(glm::vec3(x, y, z));
-
-			}
-			else if (indice == "vn") {
-				float x, y, z;
-				iss >> x >> y >> z;
-				normals.push_back(glm::vec3(x, y, z));
-			}
-			else if (indice == "vt") {
-				float u, v;
-				iss >> u >> v;
-				textures.push_back(glm::vec2(u, v));
-			}
-			else if (indice == "f") {
-				std::string f1, f2, f3;
-				iss >> f1 >> f2 >> f3;
-
-				std::string p, t, n;
-
-				//for face 1
-				Vertex v1;
-
-				p = f1.substr(0, f1.find("/"));
-				f1.erase(0, f1.find("/") + 1);
-
-				t = f1.substr(0, f1.find("/"));
-				f1.erase(0, f1.find("/") + 1);
-
-				n = f1.substr(0, f1.find("/"));
-
-
-				v1.Position = positions.at(std::stof(p) - 1);
-				v1.Normal = normals.at(std::stof(n) - 1);
-				v1.Texture = textures.at(std::stof(t) - 1);
-				vertices.push_back(v1);
-
-				//for face 12
-				Vertex v2;
-
-				p = f2.substr(0, f2.find("/"));
-				f2.erase(0, f2.find("/") + 1);
-
-				t = f2.substr(0, f2.find("/"));
-				f2.erase(0, f2.find("/") + 1);
-
-				n = f2.substr(0, f2.find("/"));
-
-
-				v2.Position = positions.at(std::stof(p) - 1);
-				v2.Normal = normals.at(std::stof(n) - 1);
-				v2.Texture = textures.at(std::stof(t) - 1);
-				vertices.push_back(v2);
-
-				//for face 3
-				Vertex v3;
-
-				p = f3.substr(0, f3.find("/"));
-				f3.erase(0, f3.find("/") + 1);
-
-				t = f3.substr(0, f3.find("/"));
-				f3.erase(0, f3.find("/") + 1);
-
-				n = f3.substr(0, f3.find("/"));
-
-
-				v3.Position = positions.at(std::stof(p) - 1);
-				v3.Normal = normals.at(std::stof(n) - 1);
-				v3.Texture = textures.at(std::stof(t) - 1);
-				vertices.push_back(v3);
-			}
-		}
-		//std::cout << positions.size() << std::endl;
-		//std::cout << normals.size() << std::endl;
-		//std::cout << textures.size() << std::endl;
-		std::cout << "Load model with " << vertices.size() << " vertices" << std::endl;		// output text to console
-
-		infile.close();
-
-		numVertices = vertices.size();
-	}
+	Object(std::shared_ptr<Mesh> Mesh) : mesh(std::move(Mesh)) {}		// get the mesh from MeshRegistry::acquire
 
 	glm::vec3 getPos() {
 		return position;//glm::vec3(model[3]);
 	}
 
-	void makeObject(Shader shader, bool texture = true) {
-
-
-		//Create the VAO and VBO
-		//Put your data into your VBO
-		//Define VBO and VAO as active buffer and active vertex array
-		//Use the VAO to specify how your data should be read by your shader (glVertexAttribPointer and co)
-		//Sometimes your shader will not use texture or normal attribute
-		//you can use the boolean defined above to not specify these attribute 
-		//desactive the buffer and delete the datas when your done
-
-
-		/* This is a working but not perfect solution, you can improve it if you need/want
-		* What happens if you call this function twice on an Model ?
-		* What happens when a shader doesn't have a position, tex_coord or normal attribute ?
-		*/
-
-		float* data = new float[8 * numVertices];
-		for (int i = 0; i < numVertices; i++) {		//iterate through the vertices and get the xyz pos, the texture and the corresponding normal per vertex
-			Vertex v = vertices.at(i);
-			data[i * 8] = v.Position.x;
-			data[i * 8 + 1] = v.Position.y;
-			data[i * 8 + 2] = v.Position.z;
-
-			data[i * 8 + 3] = v.Texture.x;
-			data[i * 8 + 4] = v.Texture.y;
-
-			data[i * 8 + 5] = v.Normal.x;
-			data[i * 8 + 6] = v.Normal.y;
-			data[i * 8 + 7] = v.Normal.z;
+	// the matrix to send as M: the placement plus whatever the mesh's vertex format needs to decode positions.
+	// While the mesh is loading the loader thread still writes positionDecode, so it is not read before loaded is set
+	glm::mat4 getRenderModel() {
+		if (!mesh || !mesh->loaded.load(std::memory_order_acquire)) {
+			return model;
 		}
+		return model * mesh->positionDecode;
+	}
 
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
+	// World space bounds of the mesh under model, for culling, picking and fitting shadow frusta. They are recomputed
+	// whenever model changed since the last call; until the mesh has loaded they are empty
+	const BoundingBox& worldBox() {
+		updateBounds();
+		return worldBounds.box;
+	}
 
-		//define VBO and VAO as active buffer and active vertex array
-		glBindVertexArray(VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * numVertices, data, GL_STATIC_DRAW);
+	const BoundingSphere& worldSphere() {
+		updateBounds();
+		return worldBounds.sphere;
+	}
 
-		auto att_pos = glGetAttribLocation(shader.ID, "position");
-		glEnableVertexAttribArray(att_pos);
-		glVertexAttribPointer(att_pos, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)0);
+	void makeObject(Shader shader, bool texture = true, VertexFormat vertexFormat = VertexFormat::Float32) {
+		mesh->makeObject(shader, texture, vertexFormat);
+	}
 
+	void draw() {
+		mesh->draw();
+	}
 
-		if (texture) {
-			auto att_tex = glGetAttribLocation(shader.ID, "tex_coord");
-			glEnableVertexAttribArray(att_tex);
-			glVertexAttribPointer(att_tex, 2, GL_FLOAT, false, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+	// one draw per material of the mesh, with its colour and diffuse map, see Mesh::drawMaterials
+	void drawMaterials(Shader& shader) {
+		mesh->drawMaterials(shader);
+	}
 
+	// draws the level of detail that fits the object's size on screen, seen from cameraPosition.
+	// The distance is taken to the nearest point of the bounding sphere, so large objects are not simplified early.
+	// Nothing is drawn until the mesh has loaded, the loader thread may still be filling lods. With materialShader
+	// the level is drawn per material like drawMaterials
+	void draw(const glm::vec3& cameraPosition, const glm::mat4& projection, float viewportHeight, Shader* materialShader = nullptr) {
+		if (!mesh || !mesh->loaded.load(std::memory_order_acquire)) {
+			return;
+		}
+		const BoundingSphere& sphere = worldSphere();
+		float distance = sphere.radius < 0.0f ? glm::length(glm::vec3(model[3]) - cameraPosition)
+			: glm::length(sphere.center - cameraPosition) - sphere.radius;
+		float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		int level = mesh->selectLod(distance, scale, projection, viewportHeight);
+		if (materialShader != nullptr) {
+			mesh->drawMaterials(*materialShader, level);
+		}
+		else {
+			mesh->draw(level);
 		}
-
-		auto att_col = glGetAttribLocation(shader.ID, "normal");
-		glEnableVertexAttribArray(att_col);
-		glVertexAttribPointer(att_col, 3, GL_FLOAT, false, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-
-		//desactive the buffer
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
-		delete[] data;
-
 	}
 
-	void draw() {
-
-		//bind your vertex arrays and call glDrawArrays
-		glBindVertexArray(this->VAO);
-		glDrawArrays(GL_TRIANGLES, 0, numVertices);
+private:
+	MeshBounds worldBounds;
+	glm::mat4 boundsModel = glm::mat4(1.0f);
+	bool boundsValid = false;
 
+	void updateBounds() {
+		if (boundsValid && model == boundsModel) {
+			return;
+		}
+		if (!mesh || !mesh->loaded.load(std::memory_order_acquire)) {
+			worldBounds = MeshBounds();
+			return;
+		}
+		worldBounds.box = mesh->bounds.box.transformed(model);
+		worldBounds.sphere = mesh->bounds.sphere.transformed(model);
+		boundsModel = model;
+		boundsValid = true;
 	}
 };
-#endif
\ No newline at end of file
+#endif
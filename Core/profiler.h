@@ -0,0 +1,129 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One recorded span, times in microseconds since the profiler started
+struct ProfileEvent {
+	std::string name;
+	std::string category;
+	std::string detail;		// e.g. the file the span worked on, empty if none
+	int64_t start;
+	int64_t duration;		// -1 for instant markers
+	unsigned thread;		// 0 is the thread that started the profiler, workers are numbered in order of appearance
+};
+
+// Collects timing spans from any thread and writes them as a Chrome trace (chrome://tracing or ui.perfetto.dev).
+// Used for the startup: file reads, parsing, decoding, shader compiles, GL uploads and the first frames
+class Profiler
+{
+public:
+	static Profiler& instance() {
+		static Profiler profiler;
+		return profiler;
+	}
+
+	int64_t now() const {
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	void record(const std::string& name, const std::string& category, const std::string& detail, int64_t start, int64_t duration) {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::map<std::thread::id, unsigned>::iterator thread = threads.find(std::this_thread::get_id());
+		if (thread == threads.end()) {
+			thread = threads.insert(std::make_pair(std::this_thread::get_id(), static_cast<unsigned>(threads.size()))).first;
+		}
+		events.push_back(ProfileEvent{ name, category, detail, start, duration, thread->second });
+	}
+
+	// a point in time, like "first frame"
+	void mark(const std::string& name, const std::string& category) {
+		record(name, category, "", now(), -1);
+	}
+
+	std::vector<ProfileEvent> snapshot() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return events;
+	}
+
+	bool writeChromeTrace(const std::string& path) {
+		std::vector<ProfileEvent> recorded = snapshot();
+		FILE* file = std::fopen(path.c_str(), "w");
+		if (file == nullptr) {
+			std::cout << "ERROR::PROFILER::CANNOT_WRITE: " << path << std::endl;
+			return false;
+		}
+		// one event per line, StartupBenchmark reads them back line by line
+		std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		for (size_t i = 0; i < recorded.size(); i++) {
+			const ProfileEvent& e = recorded[i];
+			std::fprintf(file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\",\"ts\":%lld,", escape(e.name).c_str(), escape(e.category).c_str(),
+				e.duration < 0 ? "i" : "X", static_cast<long long>(e.start));
+			if (e.duration >= 0) {
+				std::fprintf(file, "\"dur\":%lld,", static_cast<long long>(e.duration));
+			}
+			else {
+				std::fprintf(file, "\"s\":\"g\",");
+			}
+			std::fprintf(file, "\"pid\":1,\"tid\":%u", e.thread);
+			if (!e.detail.empty()) {
+				std::fprintf(file, ",\"args\":{\"detail\":\"%s\"}", escape(e.detail).c_str());
+			}
+			std::fprintf(file, "}%s\n", i + 1 < recorded.size() ? "," : "");
+		}
+		std::fprintf(file, "]}\n");
+		return std::fclose(file) == 0;
+	}
+
+private:
+	std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	std::mutex mutex;
+	std::vector<ProfileEvent> events;
+	std::map<std::thread::id, unsigned> threads;
+
+	Profiler() {
+		threads[std::this_thread::get_id()] = 0;
+	}
+
+	static std::string escape(const std::string& text) {
+		std::string escaped;
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				escaped += '\\';
+			}
+			escaped += c;
+		}
+		return escaped;
+	}
+};
+
+// Records the time from construction to destruction as one span
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name, const char* category, const std::string& detail = std::string())
+		: name(name), category(category), detail(detail), start(Profiler::instance().now()) {}
+
+	~ProfileScope() {
+		Profiler& profiler = Profiler::instance();
+		profiler.record(name, category, detail, start, profiler.now() - start);
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* name;
+	const char* category;
+	std::string detail;
+	int64_t start;
+};
+#endif
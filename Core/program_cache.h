@@ -0,0 +1,170 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include <glad/glad.h>
+
+#include "asset_pack.h"
+#include "profiler.h"
+
+// Header of a .vrprog file: a linked program as glGetProgramBinary returned it
+struct ProgramFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t binaryFormat;
+	uint64_t key;		// ProgramCache::key of the sources it was linked from
+	uint64_t size;
+	uint64_t payloadHash;
+};
+
+// Linked programs kept on disk between runs, one <key>.vrprog per program in the cache directory. The key hashes the
+// shader sources together with the GL vendor, renderer and version, so an edited shader or another driver simply
+// misses. A binary the driver rejects anyway (drivers may refuse their own after an update) is linked from source
+// again and replaced. Needs GL_ARB_get_program_binary (GL 4.1), without it every program is compiled as before
+class ProgramCache
+{
+public:
+	static const uint32_t VERSION = 1;
+
+	static ProgramCache& shared() {
+		static ProgramCache cache;
+		return cache;
+	}
+
+	// when set, cached binaries are ignored and written anew, like MeshCache::forceRebuild
+	static bool& forceRebuild() {
+		static bool force = false;
+		return force;
+	}
+
+	// where the binaries go, created on the first store. Without a directory nothing is cached
+	void setDirectory(const std::string& path) {
+		directory = path;
+	}
+
+	bool enabled() const {
+		return !directory.empty() && GLAD_GL_ARB_get_program_binary;
+	}
+
+	// the sources in the order they are attached, the context needs to be current
+	uint64_t key(const std::vector<std::string>& sources) {
+		if (driver.empty()) {
+			for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+				const GLubyte* value = glGetString(name);
+				driver += value == nullptr ? "" : reinterpret_cast<const char*>(value);
+				driver += '\n';
+			}
+		}
+		std::string all(driver);
+		for (const std::string& source : sources) {
+			all += std::to_string(source.size()) + '\n' + source;
+		}
+		return AssetPack::hashBytes(all.data(), all.size());
+	}
+
+	// A new program restored from the binary cached for key, 0 if there is none or the driver rejected it
+	GLuint load(uint64_t key) {
+		if (!enabled() || forceRebuild()) {
+			return 0;
+		}
+		ProfileScope loading("load program binary", "shader");
+		AssetFile file;
+		if (!file.open(pathFor(key).c_str()) || file.data() == nullptr || file.size() < sizeof(ProgramFileHeader)) {
+			return 0;
+		}
+		const ProgramFileHeader* header = reinterpret_cast<const ProgramFileHeader*>(file.data());
+		const char* binary = file.data() + sizeof(ProgramFileHeader);
+		if (std::memcmp(header->magic, "VRPROG\0", 8) != 0 || header->version != VERSION || header->key != key ||
+			header->size != file.size() - sizeof(ProgramFileHeader) || AssetPack::hashBytes(binary, size_t(header->size)) != header->payloadHash) {
+			std::cout << "WARNING::PROGRAM_CACHE::CORRUPT: " << pathFor(key) << std::endl;
+			return 0;
+		}
+		GLuint program = glCreateProgram();
+		glProgramBinary(program, header->binaryFormat, binary, GLsizei(header->size));
+		GLint success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	// call before linking a program that is going to be stored
+	void prepare(GLuint program) {
+		if (enabled()) {
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+	}
+
+	// Writes the binary of the linked program, to a temporary file that is renamed like the other caches
+	void store(uint64_t key, GLuint program) {
+		if (!enabled()) {
+			return;
+		}
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) {
+			return;
+		}
+		std::vector<char> binary(static_cast<size_t>(length));
+		GLenum format = 0;
+		glGetProgramBinary(program, length, &length, &format, binary.data());
+		binary.resize(static_cast<size_t>(length));
+
+		ProgramFileHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, "VRPROG\0", 8);
+		header.version = VERSION;
+		header.binaryFormat = format;
+		header.key = key;
+		header.size = binary.size();
+		header.payloadHash = AssetPack::hashBytes(binary.data(), binary.size());
+
+		makeDirectory();
+		std::string path = pathFor(key);
+		std::string temporary = path + ".tmp";
+		FILE* file = std::fopen(temporary.c_str(), "wb");
+		if (file == nullptr) {
+			std::cout << "WARNING::PROGRAM_CACHE::CANNOT_WRITE: " << path << std::endl;
+			return;
+		}
+		bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 && std::fwrite(binary.data(), binary.size(), 1, file) == 1;
+		written = std::fclose(file) == 0 && written;
+		std::remove(path.c_str());
+		if (!written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+			std::remove(temporary.c_str());
+			std::cout << "WARNING::PROGRAM_CACHE::CANNOT_WRITE: " << path << std::endl;
+		}
+	}
+
+private:
+	std::string directory;
+	std::string driver;		// vendor, renderer and version, read once
+
+	std::string pathFor(uint64_t key) const {
+		char name[32];
+		std::snprintf(name, sizeof(name), "/%016llx.vrprog", static_cast<unsigned long long>(key));
+		return directory + name;
+	}
+
+	void makeDirectory() const {
+#ifdef _WIN32
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+};
+#endif
@@ -2,89 +2,411 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <iostream>
+#include <vector>
 
+#include "asset_pack.h"
+#include "profiler.h"
+#include "program_cache.h"
+
+// Binding points of the uniform blocks all programs share, assigned by Shader to the blocks of these names
+enum UniformBlockBinding : GLuint {
+	FRAME_BLOCK_BINDING = 0,		// "Frame", see FrameUniforms
+	LIGHTS_BLOCK_BINDING = 1,		// "Lights", see LightManager
+};
+
+// A uniform of one program, resolved once with Shader::uniform and set with Shader::set. T is the type it is set with
+template <typename T>
+struct Uniform {
+	int index = -1;		// in the uniform table of the program, -1 if it has no such active uniform
+};
+
+// A program the driver may still be compiling and linking, see Shader::relink
+struct PendingProgram {
+	GLuint program = 0;
+	GLuint vertex = 0;
+	GLuint fragment = 0;
+	uint64_t key = 0;		// of the sources in the ProgramCache
+};
+
+// The active uniforms are read from the program when it is linked, so setting one never asks the driver for its
+// location, and a value that did not change since it was last set is not uploaded again. Copies of a Shader share
+// the program and the table, so a program replaced by relink/replace is used by all of them
 class Shader
 {
 public:
-	GLuint ID;
-
 	Shader(const char* vertexPath, const char* fragmentPath)
 	{
+        ProfileScope compiling("compile shader", "shader", vertexPath);		// reading, compiling and linking
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
+        // read through AssetFile so the sources may come from the asset pack
+        AssetFile vShaderFile;
+        AssetFile fShaderFile;
+        if (vShaderFile.open(vertexPath) && fShaderFile.open(fragmentPath) && vShaderFile.data() != nullptr && fShaderFile.data() != nullptr)
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-        }
-        catch (std::ifstream::failure& e)
+            vertexCode.assign(vShaderFile.data(), vShaderFile.end());
+            fragmentCode.assign(fShaderFile.data(), fShaderFile.end());
+        }
+        else
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << vertexPath << ", " << fragmentPath << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-
-        GLuint vertex = compileShader(vertexCode, GL_VERTEX_SHADER);
-        GLuint fragment = compileShader(fragmentCode, GL_FRAGMENT_SHADER);
-        ID = compileProgram(vertex, fragment);
+        build(vertexCode, fragmentCode);
+        program->vertexPath = vertexPath;
+        program->fragmentPath = fragmentPath;
 	}
 
     Shader(std::string vShaderCode, std::string fShaderCode)
     {
-        GLuint vertex = compileShader(vShaderCode, GL_VERTEX_SHADER);
-        GLuint fragment = compileShader(fShaderCode, GL_FRAGMENT_SHADER);
-        ID = compileProgram(vertex, fragment);
+        ProfileScope compiling("compile shader", "shader");
+        build(vShaderCode, fShaderCode);
+    }
+
+    GLuint id() const {
+        return program->id;
+    }
+
+    // the files the shader was built from, empty if it was built from code
+    const std::string& vertexPath() const {
+        return program->vertexPath;
+    }
+    const std::string& fragmentPath() const {
+        return program->fragmentPath;
     }
 
     void use() {
-        glUseProgram(ID);
+        glUseProgram(program->id);
     }
+    // by name, looked up in the table; for uniforms set every draw resolve a handle once instead
     void setInteger(const GLchar *name, GLint value) {
-        glUniform1i(glGetUniformLocation(ID, name), value);
+        set(Uniform<GLint>{ find(name) }, value);
     }
     void setFloat(const GLchar* name, GLfloat value) {
-        glUniform1f(glGetUniformLocation(ID, name), value);
+        set(Uniform<GLfloat>{ find(name) }, value);
     }
     void setVector3f(const GLchar* name, GLfloat x, GLfloat y, GLfloat z) {
-        glUniform3f(glGetUniformLocation(ID, name), x, y, z);
+        set(Uniform<glm::vec3>{ find(name) }, glm::vec3(x, y, z));
     }
     void setVector3f(const GLchar* name, const glm::vec3& value) {
-        glUniform3f(glGetUniformLocation(ID, name), value.x, value.y, value.z);
+        set(Uniform<glm::vec3>{ find(name) }, value);
     }
     void setMatrix4(const GLchar* name, const glm::mat4& matrix) {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, glm::value_ptr(matrix));
+        set(Uniform<glm::mat4>{ find(name) }, matrix);
+    }
+
+    // Handle of the active uniform name, warns if it is declared with another type than T. A uniform the program does
+    // not use gives a handle that sets nothing, like location -1. Handles stay valid when the program is replaced
+    template <typename T>
+    Uniform<T> uniform(const GLchar* name) const {
+        Uniform<T> handle{ find(name) };
+        if (handle.index >= 0 && !accepts(program->slots[handle.index].type, glType(T()))) {
+            std::cout << "WARNING::SHADER::UNIFORM_TYPE: " << name << std::endl;
+        }
+        return handle;
+    }
+
+    // the program has to be in use, like for glUniform
+    void set(Uniform<GLint> handle, GLint value) {
+        if (changed(handle.index, &value, sizeof(value))) {
+            glUniform1i(program->slots[handle.index].location, value);
+        }
+    }
+    void set(Uniform<GLfloat> handle, GLfloat value) {
+        if (changed(handle.index, &value, sizeof(value))) {
+            glUniform1f(program->slots[handle.index].location, value);
+        }
+    }
+    void set(Uniform<glm::vec3> handle, const glm::vec3& value) {
+        if (changed(handle.index, glm::value_ptr(value), sizeof(value))) {
+            glUniform3fv(program->slots[handle.index].location, 1, glm::value_ptr(value));
+        }
+    }
+    void set(Uniform<glm::mat4> handle, const glm::mat4& value) {
+        if (changed(handle.index, glm::value_ptr(value), sizeof(value))) {
+            glUniformMatrix4fv(program->slots[handle.index].location, 1, GL_FALSE, glm::value_ptr(value));
+        }
+    }
+
+    // the value last set through handle, false if it was never set
+    template <typename T>
+    bool get(Uniform<T> handle, T& value) const {
+        if (handle.index < 0 || !program->slots[handle.index].set) {
+            return false;
+        }
+        std::memcpy(&value, program->slots[handle.index].value, sizeof(T));
+        return true;
+    }
+
+    // number of active uniforms, every element of an array counted
+    size_t uniformCount() const {
+        size_t count = 0;
+        for (const UniformSlot& slot : program->slots) {
+            count += slot.location >= 0 ? 1 : 0;
+        }
+        return count;
+    }
+
+    // Starts compiling and linking new sources without waiting for the driver, which with
+    // GL_KHR_parallel_shader_compile does it on its own threads. The attributes keep the locations they have in the
+    // current program, so the vertex arrays of the meshes stay valid. Hand the result to replace once finished
+    PendingProgram relink(const std::string& vertexCode, const std::string& fragmentCode) const {
+        PendingProgram pending;
+        pending.key = ProgramCache::shared().enabled() ? ProgramCache::shared().key({ vertexCode, fragmentCode }) : 0;
+        pending.vertex = startShader(vertexCode, GL_VERTEX_SHADER);
+        pending.fragment = startShader(fragmentCode, GL_FRAGMENT_SHADER);
+        pending.program = startProgram(pending.vertex, pending.fragment, program->id);
+        return pending;
+    }
+
+    // whether replace would not have to wait for the driver; always true without a parallel compile extension
+    static bool finished(const PendingProgram& pending) {
+        if (!GLAD_GL_KHR_parallel_shader_compile && !GLAD_GL_ARB_parallel_shader_compile) {
+            return true;
+        }
+        GLint done = GL_FALSE;
+        glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+
+    // Uses the pending program from now on if it linked, with the uniform values set so far, and deletes the old
+    // one. If it did not, the errors are printed and the current program stays. Returns whether it was replaced
+    bool replace(PendingProgram& pending) {
+        bool success = checkShader(pending.vertex, GL_VERTEX_SHADER);
+        success = checkShader(pending.fragment, GL_FRAGMENT_SHADER) && success;
+        success = checkProgram(pending.program) && success;
+        glDeleteShader(pending.vertex);
+        glDeleteShader(pending.fragment);
+        if (!success) {
+            glDeleteProgram(pending.program);
+            pending = PendingProgram();
+            return false;
+        }
+        ProgramCache::shared().store(pending.key, pending.program);
+        glDeleteProgram(program->id);
+        program->id = pending.program;
+        reflect();
+        restore();
+        pending = PendingProgram();
+        return true;
+    }
+
+    // drops a pending program that is not needed anymore
+    static void discard(PendingProgram& pending) {
+        glDeleteShader(pending.vertex);
+        glDeleteShader(pending.fragment);
+        glDeleteProgram(pending.program);
+        pending = PendingProgram();
     }
 
 private:
+    // one active uniform, or one element of an array, with the value it was last set to
+    struct UniformSlot {
+        uint32_t hash;
+        std::string name;
+        GLint location;		// -1 once a new program does not have it anymore
+        GLenum type;
+        bool set;
+        GLfloat value[16];
+    };
+
+    // the GL program and its uniforms, shared by the copies of a Shader
+    struct Program {
+        GLuint id = 0;
+        std::vector<UniformSlot> slots;		// a Uniform handle is an index, a slot keeps it when the program is replaced
+        std::vector<std::pair<uint32_t, int>> byHash;		// hash of the name and slot, sorted
+        std::string vertexPath;
+        std::string fragmentPath;
+    };
+
+    std::shared_ptr<Program> program;
+
+    // FNV-1a
+    static uint32_t hashName(const char* name) {
+        uint32_t hash = 2166136261u;
+        for (; *name != '\0'; name++) {
+            hash = (hash ^ uint8_t(*name)) * 16777619u;
+        }
+        return hash;
+    }
+
+    int find(const GLchar* name) const {
+        uint32_t hash = hashName(name);
+        const std::vector<std::pair<uint32_t, int>>& byHash = program->byHash;
+        auto it = std::lower_bound(byHash.begin(), byHash.end(), std::make_pair(hash, -1));
+        for (; it != byHash.end() && it->first == hash; ++it) {
+            if (program->slots[it->second].name == name) {
+                return it->second;
+            }
+        }
+        return -1;
+    }
+
+    // remembers value and tells whether it has to be uploaded
+    bool changed(int index, const void* value, size_t bytes) {
+        if (index < 0) {
+            return false;
+        }
+        UniformSlot& slot = program->slots[index];
+        if (slot.set && std::memcmp(slot.value, value, bytes) == 0) {
+            return false;
+        }
+        std::memcpy(slot.value, value, bytes);
+        slot.set = true;
+        return slot.location >= 0;		// kept for a later program that has the uniform again
+    }
+
+    static GLenum glType(GLint) { return GL_INT; }
+    static GLenum glType(GLfloat) { return GL_FLOAT; }
+    static GLenum glType(const glm::vec3&) { return GL_FLOAT_VEC3; }
+    static GLenum glType(const glm::mat4&) { return GL_FLOAT_MAT4; }
+
+    // samplers and booleans are set as integers
+    static bool accepts(GLenum declared, GLenum set) {
+        if (declared == set) {
+            return true;
+        }
+        return set == GL_INT && (declared == GL_BOOL || declared == GL_SAMPLER_2D || declared == GL_SAMPLER_CUBE ||
+            declared == GL_SAMPLER_2D_ARRAY || declared == GL_SAMPLER_3D || declared == GL_SAMPLER_2D_SHADOW);
+    }
+
+    // Reads the active uniforms of the linked program. An array gets one slot per element and one under its plain name
+    // for the first element, the names glGetUniformLocation accepts. Slots of a previous program are kept in place
+    void reflect() {
+        for (UniformSlot& slot : program->slots) {
+            slot.location = -1;
+        }
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program->id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program->id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++) {
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program->id, GLuint(i), GLsizei(buffer.size()), nullptr, &size, &type, buffer.data());
+            std::string name(buffer.data());
+            size_t bracket = name.rfind("[0]");
+            if (bracket != std::string::npos && bracket + 3 == name.size()) {
+                std::string base = name.substr(0, bracket);
+                addSlot(base, type);
+                for (GLint element = 0; element < size; element++) {
+                    addSlot(base + "[" + std::to_string(element) + "]", type);
+                }
+            }
+            else {
+                addSlot(name, type);
+            }
+        }
+        program->byHash.clear();
+        for (size_t i = 0; i < program->slots.size(); i++) {
+            program->byHash.push_back({ program->slots[i].hash, int(i) });
+        }
+        std::sort(program->byHash.begin(), program->byHash.end());
+        bindBlock("Frame", FRAME_BLOCK_BINDING);
+        bindBlock("Lights", LIGHTS_BLOCK_BINDING);
+    }
+
+    void bindBlock(const GLchar* name, GLuint binding) {
+        GLuint block = glGetUniformBlockIndex(program->id, name);
+        if (block != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program->id, block, binding);
+        }
+    }
+
+    // members of uniform blocks have no location and are left out
+    void addSlot(const std::string& name, GLenum type) {
+        GLint location = glGetUniformLocation(program->id, name.c_str());
+        if (location < 0) {
+            return;
+        }
+        int index = find(name.c_str());
+        if (index < 0) {
+            program->slots.push_back(UniformSlot{ hashName(name.c_str()), name, location, type, false, {} });
+            return;
+        }
+        UniformSlot& slot = program->slots[index];
+        slot.location = location;
+        slot.set = slot.set && slot.type == type;		// a value of another type is not carried over
+        slot.type = type;
+    }
+
+    // uploads the values set so far into a new program
+    void restore() {
+        GLint current = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+        glUseProgram(program->id);
+        for (const UniformSlot& slot : program->slots) {
+            if (!slot.set || slot.location < 0) {
+                continue;
+            }
+            switch (slot.type) {
+            case GL_FLOAT:
+                glUniform1fv(slot.location, 1, slot.value);
+                break;
+            case GL_FLOAT_VEC3:
+                glUniform3fv(slot.location, 1, slot.value);
+                break;
+            case GL_FLOAT_MAT4:
+                glUniformMatrix4fv(slot.location, 1, GL_FALSE, slot.value);
+                break;
+            default: {
+                GLint value;
+                std::memcpy(&value, slot.value, sizeof(value));
+                glUniform1i(slot.location, value);
+            }
+            }
+        }
+        glUseProgram(GLuint(current));
+    }
+
+    // the program from the ProgramCache if it holds one for these sources, otherwise compiled, linked and stored
+    void build(const std::string& vertexCode, const std::string& fragmentCode) {
+        program = std::make_shared<Program>();
+        ProgramCache& cache = ProgramCache::shared();
+        uint64_t key = cache.enabled() ? cache.key({ vertexCode, fragmentCode }) : 0;
+        program->id = cache.load(key);
+        if (program->id == 0) {
+            GLuint vertex = compileShader(vertexCode, GL_VERTEX_SHADER);
+            GLuint fragment = compileShader(fragmentCode, GL_FRAGMENT_SHADER);
+            program->id = compileProgram(vertex, fragment);
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+            GLint success = 0;
+            glGetProgramiv(program->id, GL_LINK_STATUS, &success);
+            if (success) {
+                cache.store(key, program->id);
+            }
+        }
+        reflect();
+    }
+
     GLuint compileShader(std::string shaderCode, GLenum shaderType)
+    {
+        GLuint shader = startShader(shaderCode, shaderType);
+        checkShader(shader, shaderType);
+        return shader;
+    }
+
+    static GLuint startShader(const std::string& shaderCode, GLenum shaderType)
     {
         GLuint shader = glCreateShader(shaderType);
         const char* code = shaderCode.c_str();
         glShaderSource(shader, 1, &code, NULL);
         glCompileShader(shader);
+        return shader;
+    }
 
+    static bool checkShader(GLuint shader, GLenum shaderType)
+    {
         GLchar infoLog[1024];
         GLint success;
         glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
@@ -100,18 +422,45 @@ private:
             }
             std::cout << "ERROR::SHADER_COMPILATION_ERROR of the " << t << ": " << shaderType << infoLog << std::endl;
         }
-        return shader;
+        return success != 0;
     }
 
     GLuint compileProgram(GLuint vertexShader, GLuint fragmentShader)
+    {
+        GLuint programID = startProgram(vertexShader, fragmentShader, 0);
+        checkProgram(programID);
+        return programID;
+    }
+
+    // links the shaders, with the attribute locations of previous if it is not 0
+    static GLuint startProgram(GLuint vertexShader, GLuint fragmentShader, GLuint previous)
     {
         GLuint programID = glCreateProgram();
 
         glAttachShader(programID, vertexShader);
         glAttachShader(programID, fragmentShader);
+        if (previous != 0) {
+            GLint count = 0, maxLength = 0;
+            glGetProgramiv(previous, GL_ACTIVE_ATTRIBUTES, &count);
+            glGetProgramiv(previous, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+            std::vector<GLchar> name(std::max(maxLength, 1));
+            for (GLint i = 0; i < count; i++) {
+                GLint size = 0;
+                GLenum type = 0;
+                glGetActiveAttrib(previous, GLuint(i), GLsizei(name.size()), nullptr, &size, &type, name.data());
+                GLint location = glGetAttribLocation(previous, name.data());
+                if (location >= 0) {
+                    glBindAttribLocation(programID, GLuint(location), name.data());
+                }
+            }
+        }
+        ProgramCache::shared().prepare(programID);
         glLinkProgram(programID);
+        return programID;
+    }
 
-
+    static bool checkProgram(GLuint programID)
+    {
         GLchar infoLog[1024];
         GLint success;
         glGetProgramiv(programID, GL_LINK_STATUS, &success);
@@ -120,8 +469,8 @@ private:
             glGetProgramInfoLog(programID, 1024, NULL, infoLog);
             std::cout << "ERROR::PROGRAM_LINKING_ERROR:  " << infoLog << std::endl;
         }
-        return programID;
+        return success != 0;
     }
 
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,180 @@
+#ifndef SHADER_RELOADER_H
+#define SHADER_RELOADER_H
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+// Rebuilds the watched shaders when their files change, while the scene keeps running. The directory is watched with
+// inotify on Linux; elsewhere the files are stat'ed twice a second. A changed program is compiled and linked by the
+// driver in the background (GL_KHR_parallel_shader_compile, where available) and swapped in between two frames once
+// it linked; with errors they are printed and the previous program stays. The sources are read from disk, not from
+// the asset pack, since that is where they are edited
+class ShaderReloader
+{
+public:
+	explicit ShaderReloader(const std::string& directory) : directory(directory) {
+#ifdef __linux__
+		notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (notify >= 0 && inotify_add_watch(notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+			close(notify);
+			notify = -1;
+		}
+		if (notify < 0) {
+			std::cout << "WARNING::SHADER_RELOADER::NOT_WATCHED: " << directory << ", polling instead" << std::endl;
+		}
+#endif
+		if (GLAD_GL_KHR_parallel_shader_compile) {
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);		// as many threads as the driver likes
+		}
+		else if (GLAD_GL_ARB_parallel_shader_compile) {
+			glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+		}
+	}
+
+	~ShaderReloader() {
+#ifdef __linux__
+		if (notify >= 0) {
+			close(notify);
+		}
+#endif
+		if (glfwGetCurrentContext() != nullptr) {
+			for (Watched& watched : shaders) {
+				if (watched.pending.program != 0) {
+					Shader::discard(watched.pending);
+				}
+			}
+		}
+	}
+
+	ShaderReloader(const ShaderReloader&) = delete;
+	ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+	// shader has to be built from files in the directory; the reloader keeps a copy, which shares its program
+	void watch(const Shader& shader) {
+		if (shader.vertexPath().empty()) {
+			std::cout << "WARNING::SHADER_RELOADER::NO_FILES: shader built from code" << std::endl;
+			return;
+		}
+		shaders.push_back(Watched{ shader, PendingProgram(), modified(shader.vertexPath()), modified(shader.fragmentPath()) });
+	}
+
+	// Once per frame on the thread that owns the GL context: swaps in the programs started in an earlier call that
+	// finished, then starts rebuilding the shaders whose files changed. A program is never checked in the call that
+	// started it; without a parallel compile extension that one frame is all the driver gets before replace asks it
+	// for the result. Never waits for the driver when it compiles in parallel
+	void update() {
+		std::set<std::string> changed = changedFiles();
+		for (Watched& watched : shaders) {
+			if (watched.pending.program != 0 && Shader::finished(watched.pending)) {
+				if (watched.shader.replace(watched.pending)) {
+					std::cout << "Reloaded " << fileName(watched.shader.vertexPath()) << ", " << fileName(watched.shader.fragmentPath()) << std::endl;
+				}
+				else {
+					std::cout << "ERROR::SHADER_RELOADER::KEPT_PREVIOUS: " << fileName(watched.shader.fragmentPath()) << std::endl;
+				}
+			}
+			if (changed.count(fileName(watched.shader.vertexPath())) || changed.count(fileName(watched.shader.fragmentPath()))) {
+				rebuild(watched);
+			}
+		}
+	}
+
+private:
+	struct Watched {
+		Shader shader;
+		PendingProgram pending;		// program 0 while nothing is compiling
+		int64_t vertexTime;		// modification times, for polling
+		int64_t fragmentTime;
+	};
+
+	std::string directory;
+	std::vector<Watched> shaders;
+	int notify = -1;
+	std::chrono::steady_clock::time_point lastPoll = std::chrono::steady_clock::now();
+
+	// an edit made while the previous one is still compiling replaces it
+	void rebuild(Watched& watched) {
+		std::string vertexCode, fragmentCode;
+		if (!readFile(watched.shader.vertexPath(), vertexCode) || !readFile(watched.shader.fragmentPath(), fragmentCode)) {
+			std::cout << "ERROR::SHADER_RELOADER::FILE_NOT_READ: " << watched.shader.fragmentPath() << std::endl;
+			return;
+		}
+		if (watched.pending.program != 0) {
+			Shader::discard(watched.pending);
+		}
+		watched.pending = watched.shader.relink(vertexCode, fragmentCode);
+	}
+
+	// names of the files in the directory written since the last call
+	std::set<std::string> changedFiles() {
+		std::set<std::string> changed;
+#ifdef __linux__
+		if (notify >= 0) {
+			alignas(struct inotify_event) char buffer[4096];
+			ssize_t length;
+			while ((length = read(notify, buffer, sizeof(buffer))) > 0) {
+				for (ssize_t offset = 0; offset < length;) {
+					const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+					if (event->len > 0) {
+						changed.insert(event->name);
+					}
+					offset += sizeof(struct inotify_event) + event->len;
+				}
+			}
+			return changed;
+		}
+#endif
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now - lastPoll < std::chrono::milliseconds(500)) {
+			return changed;
+		}
+		lastPoll = now;
+		for (Watched& watched : shaders) {
+			int64_t vertexTime = modified(watched.shader.vertexPath());
+			int64_t fragmentTime = modified(watched.shader.fragmentPath());
+			if (vertexTime != watched.vertexTime || fragmentTime != watched.fragmentTime) {
+				changed.insert(fileName(watched.shader.fragmentPath()));
+			}
+			watched.vertexTime = vertexTime;
+			watched.fragmentTime = fragmentTime;
+		}
+		return changed;
+	}
+
+	static std::string fileName(const std::string& path) {
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? path : path.substr(slash + 1);
+	}
+
+	static int64_t modified(const std::string& path) {
+		struct stat info;
+		return stat(path.c_str(), &info) == 0 ? static_cast<int64_t>(info.st_mtime) : 0;
+	}
+
+	static bool readFile(const std::string& path, std::string& contents) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			return false;
+		}
+		std::ostringstream stream;
+		stream << file.rdbuf();
+		contents = stream.str();
+		return true;
+	}
+};
+#endif
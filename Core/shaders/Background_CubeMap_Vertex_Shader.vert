@@ -4,8 +4,14 @@ in vec2 tex_coords;
 in vec3 normal; 
 
 //only P and V are necessary
-uniform mat4 V; 
-uniform mat4 P; 
+// per frame, the same in every program (FrameData in frame_uniforms.h)
+layout(std140) uniform Frame {
+    mat4 V; //view
+    mat4 P; //projection
+    mat4 VP; //projection * view
+    vec3 u_view_pos;
+    float time; //seconds since the start
+};
 
 out vec3 texCoord_v; 
 
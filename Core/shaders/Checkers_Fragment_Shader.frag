@@ -7,43 +7,65 @@ in vec3 v_frag_coord;
 in vec3 v_normal;
 in vec2 TexCoord;
 
-uniform vec3 u_view_pos;
+// per frame, the same in every program (FrameData in frame_uniforms.h)
+layout(std140) uniform Frame {
+    mat4 V; //view
+    mat4 P; //projection
+    mat4 VP; //projection * view
+    vec3 u_view_pos;
+    float time; //seconds since the start
+};
 
-// Establish light
+// all lights of the scene, the same in every lit program (LightManager in light_manager.h)
 struct Light {
     vec3 light_pos;
     float ambient_strength;
     float diffuse_strength;
     float specular_strength;
-    float constant;
+    float constant; //attenuation factors
     float linear;
     float quadratic;
+    int mask; //lights the programs whose light_mask shares a bit with it
+};
+
+#define MAX_LIGHTS 256
+layout(std140) uniform Lights {
+    int light_count;
+    Light lights[MAX_LIGHTS];
 };
 
-uniform Light light;
+uniform int light_mask;
 uniform float shininess;
 uniform float selected;
 
-uniform sampler2D ourTexture;
+uniform sampler2DArray ourTexture;
+uniform float layer; // of ourTexture, one per piece and field color
 
 void main() {
     vec3 N = normalize(v_normal); //normalized surface normal
-    vec3 L = normalize(light.light_pos - v_frag_coord); //normalized light source vector
     vec3 V = normalize(u_view_pos - v_frag_coord); //normalized view direction vector
 
-    float specular = 0.0; //specular reflection
-    if (shininess > 0.0) {
-        vec3 R = reflect(-L, N);
-        float cosTheta = dot(R, V);
-        specular = light.specular_strength * pow(max(cosTheta, 0.0), shininess);
-    }
+    float calculatedLight = 0.0;
+    for (int i = 0; i < light_count; ++i) {
+        if ((lights[i].mask & light_mask) == 0) {
+            continue;
+        }
+        vec3 L = normalize(lights[i].light_pos - v_frag_coord); //normalized light source vector
+
+        float specular = 0.0; //specular reflection
+        if (shininess > 0.0) {
+            vec3 R = reflect(-L, N);
+            float cosTheta = dot(R, V);
+            specular = lights[i].specular_strength * pow(max(cosTheta, 0.0), shininess);
+        }
 
-    float diffuse = light.diffuse_strength * max(dot(N, L), 0.0); //diffuse reflection
-    float distance = length(light.light_pos - v_frag_coord);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * distance * distance);
-    float calculatedLight = light.ambient_strength + attenuation * (diffuse + specular); //combine ambient, diffuse and specular
+        float diffuse = lights[i].diffuse_strength * max(dot(N, L), 0.0); //diffuse reflection
+        float distance = length(lights[i].light_pos - v_frag_coord);
+        float attenuation = 1.0 / (lights[i].constant + lights[i].linear * distance + lights[i].quadratic * distance * distance);
+        calculatedLight += lights[i].ambient_strength + attenuation * (diffuse + specular); //combine ambient, diffuse and specular
+    }
 
-    vec3 textureColor = texture(ourTexture, TexCoord).xyz; //retrieve the texture as well
+    vec3 textureColor = texture(ourTexture, vec3(TexCoord, layer)).xyz; //retrieve the texture as well
     vec3 glowColor = vec3(1.0, 1.0, 0.0); // Set the glow color (yellow in this example)
     float glowIntensity = 8.0; // Adjust glow intensity
 
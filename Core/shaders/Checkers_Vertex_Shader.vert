@@ -12,13 +12,19 @@ out vec3 LightPos; // Pass the light position to the fragment shader
 
 uniform mat4 M; //model
 uniform mat4 itM; //inverse transposed model
-uniform mat4 V; //view
-uniform mat4 P; //projection
+// per frame, the same in every program (FrameData in frame_uniforms.h)
+layout(std140) uniform Frame {
+    mat4 V; //view
+    mat4 P; //projection
+    mat4 VP; //projection * view
+    vec3 u_view_pos;
+    float time; //seconds since the start
+};
 uniform vec3 lightPos; // The position of the light source
 
 void main() {
     vec4 frag_coord = M * vec4(position, 1.0);
-    gl_Position = P * V * M * vec4(position, 1);
+    gl_Position = VP * frag_coord;
 
     v_normal = vec3(itM * vec4(normal, 0.0)); //cancels out non-uniform scaling part of the original model matrix (maintains orthogonality)
     v_frag_coord = frag_coord.xyz;
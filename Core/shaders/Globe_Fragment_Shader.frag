@@ -7,20 +7,34 @@ in vec3 v_frag_coord;
 in vec3 v_normal;
 in vec2 TexCoord;
 
-uniform vec3 u_view_pos;
+// per frame, the same in every program (FrameData in frame_uniforms.h)
+layout(std140) uniform Frame {
+    mat4 V; //view
+    mat4 P; //projection
+    mat4 VP; //projection * view
+    vec3 u_view_pos;
+    float time; //seconds since the start
+};
 
-// Establish light
+// all lights of the scene, the same in every lit program (LightManager in light_manager.h)
 struct Light {
     vec3 light_pos;
     float ambient_strength;
     float diffuse_strength;
     float specular_strength;
-    float constant;
+    float constant; //attenuation factors
     float linear;
     float quadratic;
+    int mask; //lights the programs whose light_mask shares a bit with it
+};
+
+#define MAX_LIGHTS 256
+layout(std140) uniform Lights {
+    int light_count;
+    Light lights[MAX_LIGHTS];
 };
 
-uniform Light light;
+uniform int light_mask;
 uniform float shininess;
 uniform float selected;
 
@@ -38,21 +52,28 @@ vec3 refractVector(vec3 I, vec3 N, float eta) {
 
 void main() {
     vec3 N = normalize(v_normal);
-    vec3 L = normalize(light.light_pos - v_frag_coord);
     vec3 V = normalize(u_view_pos - v_frag_coord);
 
-    float specular = 0.0;
-    if (shininess > 0.0) {
-        vec3 R = reflectVector(-L, N);
-        float cosTheta = dot(R, V);
-        specular = light.specular_strength * pow(max(cosTheta, 0.0), shininess);
+    float calculatedLight = 0.0;
+    for (int i = 0; i < light_count; ++i) {
+        if ((lights[i].mask & light_mask) == 0) {
+            continue;
+        }
+        vec3 L = normalize(lights[i].light_pos - v_frag_coord);
+
+        float specular = 0.0;
+        if (shininess > 0.0) {
+            vec3 R = reflectVector(-L, N);
+            float cosTheta = dot(R, V);
+            specular = lights[i].specular_strength * pow(max(cosTheta, 0.0), shininess);
+        }
+
+        float diffuse = lights[i].diffuse_strength * max(dot(N, L), 0.0);
+        float distance = length(lights[i].light_pos - v_frag_coord);
+        float attenuation = 1.0 / (lights[i].constant + lights[i].linear * distance + lights[i].quadratic * distance * distance) * 2.0;
+        calculatedLight += lights[i].ambient_strength + attenuation * (diffuse + specular);
     }
 
-    float diffuse = light.diffuse_strength * max(dot(N, L), 0.0);
-    float distance = length(light.light_pos - v_frag_coord);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * distance * distance) * 2.0;
-    float calculatedLight = light.ambient_strength + attenuation * (diffuse + specular);
-
     vec3 textureColor = texture(ourTexture, TexCoord).xyz;
     vec3 glowColor = vec3(0.0, 0.0, 1.0); // Set the glow color
     float glowIntensity = 2.0; // Adjust this intensity as needed
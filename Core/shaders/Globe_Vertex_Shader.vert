@@ -11,12 +11,18 @@ out vec3 LightPos; // Pass the light position to the fragment shader
 
 uniform mat4 M;
 uniform mat4 itM;
-uniform mat4 V;
-uniform mat4 P;
+// per frame, the same in every program (FrameData in frame_uniforms.h)
+layout(std140) uniform Frame {
+    mat4 V; //view
+    mat4 P; //projection
+    mat4 VP; //projection * view
+    vec3 u_view_pos;
+    float time; //seconds since the start
+};
 uniform vec3 lightPos; // The position of the light source
 
 void main() {
-    gl_Position = P * V * M * vec4(position, 1.0);
+    gl_Position = VP * M * vec4(position, 1.0);
 
     v_normal = normalize(vec3(itM * vec4(normal, 0.0)));
     v_frag_coord = vec3(M * vec4(position, 1.0));
@@ -5,8 +5,16 @@ precision mediump float;
 in vec3 v_frag_coord;
 in vec3 v_normal;
 
-uniform vec3 u_view_pos;
+// per frame, the same in every program (FrameData in frame_uniforms.h)
+layout(std140) uniform Frame {
+    mat4 V; //view
+    mat4 P; //projection
+    mat4 VP; //projection * view
+    vec3 u_view_pos;
+    float time; //seconds since the start
+};
 
+// all lights of the scene, the same in every lit program (LightManager in light_manager.h)
 struct Light {
     vec3 light_pos;
     float ambient_strength;
@@ -15,19 +23,23 @@ struct Light {
     float constant; //attenuation factors
     float linear;
     float quadratic;
+    int mask; //lights the programs whose light_mask shares a bit with it
 };
 
-#define MAX_LIGHTS 9
-uniform Light lights[MAX_LIGHTS]; // Array of lights
+#define MAX_LIGHTS 256
+layout(std140) uniform Lights {
+    int light_count;
+    Light lights[MAX_LIGHTS];
+};
 
-uniform Light light;
+uniform int light_mask;
 uniform float shininess;
 uniform vec3 materialColour;
 
-float blinnPhongSpecular(vec3 N, vec3 L, vec3 V) {
+float blinnPhongSpecular(vec3 N, vec3 L, vec3 V, float strength) {
     vec3 H = normalize(L + V); //half-vector
     float spec = pow(max(dot(N, H), 0.0), shininess);
-    return light.specular_strength * spec;
+    return strength * spec;
 }
 
 void main() {
@@ -36,9 +48,12 @@ void main() {
 
     vec3 totalLight = vec3(0.0); // Accumulator for total light
 
-    for (int i = 0; i < MAX_LIGHTS; ++i) {
+    for (int i = 0; i < light_count; ++i) {
+        if ((lights[i].mask & light_mask) == 0) {
+            continue;
+        }
         vec3 L = normalize(lights[i].light_pos - v_frag_coord); //normalized light source vector
-        float specular = blinnPhongSpecular(N, L, V) * 3;
+        float specular = blinnPhongSpecular(N, L, V, lights[i].specular_strength) * 3;
         float diffuse = lights[i].diffuse_strength * max(dot(N, L), 0.0) * 2;
         float distance = length(lights[i].light_pos - v_frag_coord) * 0.15;
         float attenuation = 1.0 / (lights[i].constant + lights[i].linear * distance + lights[i].quadratic * distance * distance);
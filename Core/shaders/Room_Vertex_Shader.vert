@@ -8,13 +8,19 @@ out vec3 v_normal;
 
 uniform mat4 M; 
 uniform mat4 itM; 
-uniform mat4 V; 
-uniform mat4 P; 
+// per frame, the same in every program (FrameData in frame_uniforms.h)
+layout(std140) uniform Frame {
+    mat4 V; //view
+    mat4 P; //projection
+    mat4 VP; //projection * view
+    vec3 u_view_pos;
+    float time; //seconds since the start
+};
 
 
 void main(){
 vec4 frag_coord = M*vec4(position, 1.0); 
-gl_Position = P*V*frag_coord; 
+gl_Position = VP*frag_coord; 
 v_normal = vec3(itM * vec4(normal, 1.0)); 
 v_frag_coord = frag_coord.xyz;
 }
\ No newline at end of file
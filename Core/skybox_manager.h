@@ -0,0 +1,115 @@
+#ifndef SKYBOX_MANAGER_H
+#define SKYBOX_MANAGER_H
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "asset_loader.h"
+#include "texture_cache.h"
+
+// The environments the scene can be shown in, switched at runtime. A switch never waits: the current skybox stays on
+// screen until the faces of the new one are decoded (in parallel, by the AssetLoader) and uploaded, then they swap.
+// Once everything is loaded, the skybox that comes next is prefetched in the background, so cycling through them
+// swaps in the very next frame. At most the shown, the requested and the prefetched skybox are kept on the GPU
+class SkyboxManager
+{
+public:
+	explicit SkyboxManager(AssetLoader& loader) : loader(loader) {}
+
+	// the six faces dir + names, in the order +x, +y, +z, -x, -y, -z
+	static std::vector<std::pair<std::string, GLenum>> faces(const std::string& dir, const std::vector<std::string>& names) {
+		static const GLenum targets[6] = {
+			GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_TEXTURE_CUBE_MAP_POSITIVE_Y, GL_TEXTURE_CUBE_MAP_POSITIVE_Z,
+			GL_TEXTURE_CUBE_MAP_NEGATIVE_X, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z,
+		};
+		std::vector<std::pair<std::string, GLenum>> result;
+		for (size_t i = 0; i < names.size() && i < 6; i++) {
+			result.push_back({ dir + names[i], targets[i] });
+		}
+		return result;
+	}
+
+	void add(const std::string& name, const std::vector<std::pair<std::string, GLenum>>& faces) {
+		skyboxes.push_back(Skybox{ name, faces, nullptr });
+	}
+
+	size_t size() const {
+		return skyboxes.size();
+	}
+
+	const std::string& name(size_t i) const {
+		return skyboxes[i].name;
+	}
+
+	// Shows skybox i as soon as it is loaded. The first one selected is part of the startup, later ones load in the background
+	void select(size_t i) {
+		if (i >= skyboxes.size()) {
+			return;
+		}
+		wanted = i;
+		load(i, shown != NONE);
+		if (shown == NONE) {
+			shown = i;
+		}
+	}
+
+	void next() {
+		if (!skyboxes.empty()) {
+			select(((wanted == NONE ? 0 : wanted) + 1) % skyboxes.size());
+		}
+	}
+
+	// Call once per frame after AssetLoader::update: swaps in the requested skybox once it is loaded, prefetches the
+	// next one and frees the ones that are not needed anymore
+	void update() {
+		if (wanted == NONE) {
+			return;
+		}
+		if (wanted != shown && skyboxes[wanted].texture->loaded) {
+			shown = wanted;
+		}
+		size_t prefetch = (wanted + 1) % skyboxes.size();
+		if (skyboxes[shown].texture->loaded && loader.done()) {
+			load(prefetch, true);
+		}
+		for (size_t i = 0; i < skyboxes.size(); i++) {
+			if (i != shown && i != wanted && i != prefetch) {
+				skyboxes[i].texture.reset();
+			}
+		}
+	}
+
+	// the cube map to draw, nullptr before the first select
+	std::shared_ptr<Texture> current() const {
+		return shown == NONE ? nullptr : skyboxes[shown].texture;
+	}
+
+	size_t currentIndex() const {
+		return shown;
+	}
+
+private:
+	static const size_t NONE = size_t(-1);
+
+	struct Skybox {
+		std::string name;
+		std::vector<std::pair<std::string, GLenum>> faces;
+		std::shared_ptr<Texture> texture;		// nullptr while not loaded or loading
+	};
+
+	AssetLoader& loader;
+	std::vector<Skybox> skyboxes;
+	size_t shown = NONE;
+	size_t wanted = NONE;
+
+	void load(size_t i, bool background) {
+		if (!skyboxes[i].texture) {
+			skyboxes[i].texture = loader.loadCubemap(skyboxes[i].faces, background);
+		}
+	}
+};
+#endif
@@ -0,0 +1,101 @@
+#ifndef TEXTURE_BAKER_H
+#define TEXTURE_BAKER_H
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "stb_dxt.h"
+#include "stb_image.h"
+#include "stb_image_resize.h"
+
+#include "asset_pack.h"
+#include "texture_file.h"
+#include "thread_pool.h"
+
+// Offline step that turns an image into a .vrtex: BC1 (DXT1) for opaque images, BC3 (DXT5) when some texel is not,
+// with the mip chain filtered in sRGB space. BC1 takes a sixth of the memory of RGB8, BC3 a quarter of RGBA8, and
+// loading either needs no decode at all.
+// The translation unit that includes this header defines STB_DXT_IMPLEMENTATION and STB_IMAGE_RESIZE_IMPLEMENTATION
+class TextureBaker
+{
+public:
+	// Bakes imagePath unless its .vrtex is up to date. flipped must match how the loader samples the image:
+	// 2D textures are flipped, cube map faces are not. Returns false if the image could not be read or written
+	static bool bake(const std::string& imagePath, bool flipped) {
+		const TextureFileHeader* header;
+		if (TextureFile::load(imagePath, flipped, header)) {
+			return true;
+		}
+		TextureSource source;
+		AssetFile image;
+		if (!TextureFile::describe(imagePath, source) || !image.open(imagePath.c_str()) || image.data() == nullptr) {
+			std::cout << "ERROR::TEXTURE_BAKER::FILE_NOT_SUCCESFULLY_READ: " << imagePath << std::endl;
+			return false;
+		}
+		int width, height, channels;
+		stbi_set_flip_vertically_on_load_thread(flipped);
+		unsigned char* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(image.data()), static_cast<int>(image.size()),
+			&width, &height, &channels, STBI_rgb_alpha);
+		if (pixels == nullptr) {
+			std::cout << "ERROR::TEXTURE_BAKER::DECODE_FAILED: " << imagePath << " (" << stbi_failure_reason() << ")" << std::endl;
+			return false;
+		}
+		std::vector<unsigned char> level(pixels, pixels + size_t(width) * height * 4);
+		stbi_image_free(pixels);
+
+		bool alpha = false;
+		for (size_t i = 3; i < level.size() && !alpha; i += 4) {
+			alpha = level[i] != 255;
+		}
+		uint32_t internalFormat = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+		std::vector<TextureFileLevel> levels;
+		std::vector<std::vector<char>> data;
+		while (true) {
+			TextureFileLevel l = {};
+			l.width = width;
+			l.height = height;
+			levels.push_back(l);
+			data.push_back(compress(level.data(), width, height, alpha));
+			if (width == 1 && height == 1) {
+				break;
+			}
+			int nextWidth = std::max(width / 2, 1), nextHeight = std::max(height / 2, 1);
+			std::vector<unsigned char> next(size_t(nextWidth) * nextHeight * 4);
+			stbir_resize_uint8_srgb(level.data(), width, height, 0, next.data(), nextWidth, nextHeight, 0, 4,
+				alpha ? 3 : STBIR_ALPHA_CHANNEL_NONE, 0);
+			level.swap(next);
+			width = nextWidth;
+			height = nextHeight;
+		}
+		return TextureFile::write(imagePath, source, internalFormat, flipped, levels, data);
+	}
+
+private:
+	// one width x height RGBA level in 4x4 blocks, rows of blocks spread over the shared pool.
+	// Blocks past the right or bottom edge repeat the last column and row
+	static std::vector<char> compress(const unsigned char* rgba, int width, int height, bool alpha) {
+		uint32_t internalFormat = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		size_t blockBytes = TextureFile::blockSize(internalFormat);
+		int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+		std::vector<char> out(size_t(blocksX) * blocksY * blockBytes);
+		ThreadPool::shared().parallelFor(blocksY, [&](size_t by) {
+			unsigned char block[64];
+			for (int bx = 0; bx < blocksX; bx++) {
+				for (int y = 0; y < 4; y++) {
+					int row = std::min(int(by) * 4 + y, height - 1);
+					for (int x = 0; x < 4; x++) {
+						int column = std::min(bx * 4 + x, width - 1);
+						std::memcpy(block + (y * 4 + x) * 4, rgba + (size_t(row) * width + column) * 4, 4);
+					}
+				}
+				unsigned char* dest = reinterpret_cast<unsigned char*>(out.data() + (by * blocksX + bx) * blockBytes);
+				stb_compress_dxt_block(dest, block, alpha ? 1 : 0, STB_DXT_HIGHQUAL);
+			}
+		});
+		return out;
+	}
+};
+#endif
@@ -0,0 +1,137 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+// One GL texture and what it occupies on the GPU. The name is deleted with the last handle
+class Texture
+{
+public:
+	GLuint id = 0;
+	GLenum target;
+	GLenum internalFormat;		// as requested, a baked texture is stored in its compressed format instead
+	std::string path;
+	size_t gpuBytes = 0;		// all levels, as far as the format tells
+	bool loaded = false;		// the data arrived, until then it is a placeholder
+
+	Texture(GLenum target, GLenum internalFormat, const std::string& path) : target(target), internalFormat(internalFormat), path(path) {
+		glGenTextures(1, &id);
+	}
+
+	~Texture() {
+		// like Mesh, the last handle may go away after the context was destroyed
+		if (id != 0 && glfwGetCurrentContext() != nullptr) {
+			glDeleteTextures(1, &id);
+		}
+	}
+
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+
+	void bind() const {
+		glBindTexture(target, id);
+	}
+
+	// bytes of a width x height image in internalFormat, with its full mip chain if mipmapped
+	static size_t bytesOf(GLenum internalFormat, int width, int height, bool mipmapped) {
+		size_t bytes = 0;
+		while (true) {
+			bytes += size_t(width) * height * texelBytes(internalFormat);
+			if (!mipmapped || (width == 1 && height == 1)) {
+				return bytes;
+			}
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+	}
+
+	// the sized format glTexStorage2D needs for an unsized one
+	static GLenum sizedFormat(GLenum internalFormat) {
+		switch (internalFormat) {
+		case GL_RED:
+			return GL_R8;
+		case GL_RG:
+			return GL_RG8;
+		case GL_RGB:
+			return GL_RGB8;
+		case GL_RGBA:
+			return GL_RGBA8;
+		default:
+			return internalFormat;
+		}
+	}
+
+private:
+	static size_t texelBytes(GLenum internalFormat) {
+		switch (internalFormat) {
+		case GL_RED:
+		case GL_R8:
+			return 1;
+		case GL_RG:
+		case GL_RG8:
+			return 2;
+		default:
+			return 4;		// RGB is padded to four bytes by the drivers
+		}
+	}
+};
+
+// Hands out one Texture per path and internal format, so an image used by several pieces is decoded and uploaded
+// once. Like MeshRegistry it only keeps weak references: the texture is freed when its last handle is dropped and
+// loaded again if it is acquired after that. Use it from the thread that owns the GL context
+class TextureCache
+{
+public:
+	// The texture for path in internalFormat. One that is not in the cache yet is created without storage and created
+	// is set, the caller then loads it (see AssetLoader::loadTexture)
+	std::shared_ptr<Texture> acquireDeferred(const std::string& path, GLenum internalFormat, bool& created) {
+		std::weak_ptr<Texture>& entry = textures[key(path, internalFormat)];
+		std::shared_ptr<Texture> texture = entry.lock();
+		created = !texture;
+		if (created) {
+			texture = std::make_shared<Texture>(GL_TEXTURE_2D, internalFormat, path);
+			entry = texture;
+		}
+		return texture;
+	}
+
+	// number of textures that are still referenced somewhere
+	size_t size() const {
+		size_t alive = 0;
+		for (const auto& entry : textures) {
+			alive += entry.second.expired() ? 0 : 1;
+		}
+		return alive;
+	}
+
+	// GPU memory of the textures that are still referenced
+	size_t gpuBytes() const {
+		size_t bytes = 0;
+		for (const auto& entry : textures) {
+			if (std::shared_ptr<Texture> texture = entry.second.lock()) {
+				bytes += texture->gpuBytes;
+			}
+		}
+		return bytes;
+	}
+
+	// forgets the entries of freed textures
+	void prune() {
+		for (auto it = textures.begin(); it != textures.end();) {
+			it = it->second.expired() ? textures.erase(it) : std::next(it);
+		}
+	}
+
+private:
+	std::unordered_map<std::string, std::weak_ptr<Texture>> textures;
+
+	static std::string key(const std::string& path, GLenum internalFormat) {
+		return path + "#" + std::to_string(internalFormat);
+	}
+};
+#endif
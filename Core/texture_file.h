@@ -0,0 +1,199 @@
+#ifndef TEXTURE_FILE_H
+#define TEXTURE_FILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <glad/glad.h>
+
+#include "asset_pack.h"
+
+// Identity of the image a baked texture was generated from
+struct TextureSource {
+	uint64_t size = 0;
+	int64_t mtime = 0;
+	uint64_t hash = 0;
+};
+
+// Header of a .vrtex file, a small KTX like container: the texture in its GL compressed format with every mip level
+// precomputed. It is followed by one TextureFileLevel per level and the level data, each starting at a 16 byte aligned
+// offset so it can be uploaded straight from the mapping
+struct TextureFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint64_t sourceSize;
+	int64_t sourceMtime;
+	uint64_t sourceHash;
+	uint32_t internalFormat;		// GL_COMPRESSED_*_S3TC_*
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t flipped;		// rows bottom up like stbi_set_flip_vertically_on_load, as 2D textures are sampled
+	uint32_t reserved;
+	uint64_t levelOffset;
+	uint64_t payloadHash;		// hash of everything after the header
+};
+
+struct TextureFileLevel {
+	uint64_t offset;
+	uint64_t size;
+	uint32_t width;
+	uint32_t height;
+};
+
+// Baked textures are stored next to their image as <name>.vrtex by TextureBaker (see tools/asset_packer.cpp) and only
+// used while size, modification time and content hash of the image still match, like the .vrmesh caches
+class TextureFile
+{
+public:
+	static const uint32_t VERSION = 1;
+
+	static std::string pathFor(const std::string& imagePath) {
+		std::string path(imagePath);
+		size_t dot = path.find_last_of('.');
+		size_t slash = path.find_last_of("/\\");
+		if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+			path.erase(dot);
+		}
+		return path + ".vrtex";
+	}
+
+	// bytes of one level of a width x height texture in 4x4 blocks
+	static size_t levelSize(uint32_t internalFormat, uint32_t width, uint32_t height) {
+		return size_t((width + 3) / 4) * ((height + 3) / 4) * blockSize(internalFormat);
+	}
+
+	static size_t blockSize(uint32_t internalFormat) {
+		return internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? 8 : 16;
+	}
+
+	// stat and hash the image, or take both from its asset pack entry
+	static bool describe(const std::string& imagePath, TextureSource& source) {
+		AssetFile image;
+		if (!image.open(imagePath.c_str())) {
+			return false;
+		}
+		if (const AssetPackEntry* entry = image.packEntry()) {
+			source.size = entry->size;
+			source.mtime = entry->mtime;
+			source.hash = entry->hash;
+			return true;
+		}
+		struct stat info;
+		if (stat(imagePath.c_str(), &info) != 0) {
+			return false;
+		}
+		source.size = static_cast<uint64_t>(info.st_size);
+		source.mtime = static_cast<int64_t>(info.st_mtime);
+		source.hash = AssetPack::hashBytes(image.data(), image.size());
+		return true;
+	}
+
+	// Maps the baked texture of imagePath. Returns nullptr if there is none, if it is stale, corrupt or baked for the
+	// other orientation; the caller then decodes the image itself
+	static std::shared_ptr<AssetFile> load(const std::string& imagePath, bool flipped, const TextureFileHeader*& header) {
+		header = nullptr;
+		std::shared_ptr<AssetFile> file = std::make_shared<AssetFile>();
+		if (!file->open(pathFor(imagePath).c_str()) || file->data() == nullptr || file->size() < sizeof(TextureFileHeader)) {
+			return nullptr;
+		}
+		const TextureFileHeader* h = reinterpret_cast<const TextureFileHeader*>(file->data());
+		if (std::memcmp(h->magic, "VRTEX\0\0", 8) != 0 || h->version != VERSION || h->headerSize != sizeof(TextureFileHeader) ||
+			h->flipped != (flipped ? 1u : 0u)) {
+			return nullptr;
+		}
+		TextureSource source;
+		if (!describe(imagePath, source) || h->sourceSize != source.size || h->sourceMtime != source.mtime || h->sourceHash != source.hash) {
+			return nullptr;		// the image changed since it was baked
+		}
+		if (h->levelCount == 0 || h->levelOffset % 16 != 0 || h->levelOffset < sizeof(TextureFileHeader) ||
+			h->levelOffset + uint64_t(h->levelCount) * sizeof(TextureFileLevel) > file->size()) {
+			return nullptr;
+		}
+		const TextureFileLevel* levels = reinterpret_cast<const TextureFileLevel*>(file->data() + h->levelOffset);
+		for (uint32_t i = 0; i < h->levelCount; i++) {
+			if (levels[i].offset % 16 != 0 || levels[i].offset + levels[i].size > file->size() ||
+				levels[i].size != levelSize(h->internalFormat, levels[i].width, levels[i].height)) {
+				return nullptr;
+			}
+		}
+		if (AssetPack::hashBytes(file->data() + sizeof(TextureFileHeader), file->size() - sizeof(TextureFileHeader)) != h->payloadHash) {
+			std::cout << "WARNING::TEXTURE_FILE::CORRUPT: " << pathFor(imagePath) << std::endl;
+			return nullptr;
+		}
+		header = h;
+		return file;
+	}
+
+	static const TextureFileLevel& level(const AssetFile& file, const TextureFileHeader& header, uint32_t i) {
+		return reinterpret_cast<const TextureFileLevel*>(file.data() + header.levelOffset)[i];
+	}
+
+	static const char* levelData(const AssetFile& file, const TextureFileLevel& level) {
+		return file.data() + level.offset;
+	}
+
+	// The levels are given largest first, each levelSize bytes. Written to a temporary file and renamed, like MeshCache
+	static bool write(const std::string& imagePath, const TextureSource& source, uint32_t internalFormat, bool flipped,
+		const std::vector<TextureFileLevel>& levels, const std::vector<std::vector<char>>& data) {
+		TextureFileHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, "VRTEX\0\0", 8);
+		header.version = VERSION;
+		header.headerSize = sizeof(TextureFileHeader);
+		header.sourceSize = source.size;
+		header.sourceMtime = source.mtime;
+		header.sourceHash = source.hash;
+		header.internalFormat = internalFormat;
+		header.width = levels.empty() ? 0 : levels[0].width;
+		header.height = levels.empty() ? 0 : levels[0].height;
+		header.levelCount = static_cast<uint32_t>(levels.size());
+		header.flipped = flipped ? 1 : 0;
+		header.levelOffset = align16(sizeof(TextureFileHeader));
+
+		std::vector<TextureFileLevel> table(levels);
+		uint64_t offset = align16(header.levelOffset + table.size() * sizeof(TextureFileLevel));
+		for (size_t i = 0; i < table.size(); i++) {
+			table[i].offset = offset;
+			table[i].size = data[i].size();
+			offset = align16(offset + data[i].size());
+		}
+		std::vector<char> payload(offset - sizeof(TextureFileHeader), 0);
+		std::memcpy(payload.data() + header.levelOffset - sizeof(TextureFileHeader), table.data(), table.size() * sizeof(TextureFileLevel));
+		for (size_t i = 0; i < table.size(); i++) {
+			std::memcpy(payload.data() + table[i].offset - sizeof(TextureFileHeader), data[i].data(), data[i].size());
+		}
+		header.payloadHash = AssetPack::hashBytes(payload.data(), payload.size());
+
+		std::string path = pathFor(imagePath);
+		std::string temporary = path + ".tmp";
+		FILE* file = std::fopen(temporary.c_str(), "wb");
+		if (file == nullptr) {
+			std::cout << "WARNING::TEXTURE_FILE::CANNOT_WRITE: " << path << std::endl;
+			return false;
+		}
+		bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 && std::fwrite(payload.data(), payload.size(), 1, file) == 1;
+		written = std::fclose(file) == 0 && written;
+		std::remove(path.c_str());
+		if (!written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+			std::remove(temporary.c_str());
+			std::cout << "WARNING::TEXTURE_FILE::CANNOT_WRITE: " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+private:
+	static uint64_t align16(uint64_t offset) {
+		return (offset + 15) & ~uint64_t(15);
+	}
+};
+#endif
@@ -0,0 +1,148 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued tasks in submission order.
+// Tasks must not touch OpenGL, the context only lives on the main thread
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned threads = defaultThreadCount()) {
+		for (unsigned i = 0; i < std::max(threads, 1u); i++) {
+			workers.emplace_back([this]() { run(); });
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wakeup.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// pool used by the loaders, created on first use
+	static ThreadPool& shared() {
+		static ThreadPool pool;
+		return pool;
+	}
+
+	static unsigned defaultThreadCount() {
+		unsigned cores = std::thread::hardware_concurrency();
+		return cores > 1 ? cores - 1 : 1;		// leave one core to the render thread
+	}
+
+	unsigned size() const {
+		return static_cast<unsigned>(workers.size());
+	}
+
+	template <typename Task>
+	std::future<typename std::result_of<Task()>::type> submit(Task task) {
+		typedef typename std::result_of<Task()>::type Result;
+		std::shared_ptr<std::packaged_task<Result()>> packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+		std::future<Result> result = packaged->get_future();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.emplace_back([packaged]() { (*packaged)(); });
+		}
+		wakeup.notify_one();
+		return result;
+	}
+
+	// Runs body(i) for every i in [0, count). The calling thread takes part, so this also works when called from a task:
+	// the indices are handed out from a shared counter, workers that are free join in, and the caller only ever runs
+	// indices of this loop, never an unrelated queued task it would then have to wait for.
+	// If bodies throw, the exception of the lowest index is rethrown once all of them finished
+	void parallelFor(size_t count, const std::function<void(size_t)>& body) {
+		if (count == 0) {
+			return;
+		}
+		std::shared_ptr<Loop> loop = std::make_shared<Loop>(count, body);
+		size_t helpers = std::min(count - 1, workers.size());
+		for (size_t h = 0; h < helpers; h++) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				tasks.emplace_back([loop]() { loop->drain(); });		// a helper starting late finds nothing left
+			}
+			wakeup.notify_one();
+		}
+		loop->drain();
+		{
+			std::unique_lock<std::mutex> lock(loop->mutex);
+			loop->finished.wait(lock, [&loop]() { return loop->done == loop->count; });
+		}
+		for (std::exception_ptr& error : loop->errors) {
+			if (error) {
+				std::rethrow_exception(error);
+			}
+		}
+	}
+
+private:
+	// the shared state of one parallelFor, kept alive by the helper tasks that may start after it returned
+	struct Loop {
+		size_t count;
+		const std::function<void(size_t)>* body;		// only used while indices are left, so while the caller waits
+		std::atomic<size_t> next{ 0 };
+		std::vector<std::exception_ptr> errors;
+		std::mutex mutex;
+		std::condition_variable finished;
+		size_t done = 0;
+
+		Loop(size_t count, const std::function<void(size_t)>& body) : count(count), body(&body), errors(count) {}
+
+		void drain() {
+			for (size_t i = next++; i < count; i = next++) {
+				try {
+					(*body)(i);
+				}
+				catch (...) {
+					errors[i] = std::current_exception();
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				if (++done == count) {
+					finished.notify_all();
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	bool stopping = false;
+
+	void run() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeup.wait(lock, [this]() { return stopping || !tasks.empty(); });
+				if (stopping && tasks.empty()) {
+					return;
+				}
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+};
+#endif
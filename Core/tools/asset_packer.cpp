@@ -0,0 +1,243 @@
+// Packs the asset directories into one .vrpack file (see asset_pack.h), which Core maps at startup instead of opening
+// every asset on its own. The .vrmesh caches and the .vrtex textures are baked first, so a run from the pack never
+// parses an .obj or decodes an image. Assets are compressed in LZ4 blocks when that saves at least an eighth; baked
+// files stay uncompressed so they are uploaded straight from the mapping.
+// Usage: AssetPacker output.vrpack root dir [dir ...]   (dirs relative to root, the names in the pack are too)
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_DXT_IMPLEMENTATION
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "asset_pack.h"
+#include "lz4_block.h"
+#include "shader.h"
+#include "mesh.h"
+#include "texture_baker.h"
+
+struct PackedAsset {
+	std::string name;
+	std::string path;
+	AssetPackEntry entry;
+	std::vector<char> data;		// as stored in the pack
+};
+
+// files below dir, recursively, as paths relative to root
+static void listFiles(const std::string& root, const std::string& dir, std::vector<std::string>& names) {
+#ifdef _WIN32
+	WIN32_FIND_DATAA found;
+	HANDLE find = FindFirstFileA((root + "/" + dir + "/*").c_str(), &found);
+	if (find == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	do {
+		std::string name = found.cFileName;
+		bool directory = (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+	DIR* directoryStream = opendir((root + "/" + dir).c_str());
+	if (directoryStream == nullptr) {
+		return;
+	}
+	while (dirent* found = readdir(directoryStream)) {
+		std::string name = found->d_name;
+		struct stat info;
+		bool directory = stat((root + "/" + dir + "/" + name).c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+		if (name == "." || name == "..") {
+			continue;
+		}
+		if (directory) {
+			listFiles(root, dir + "/" + name, names);
+		}
+		else if (name[0] != '.' && name.find(".tmp") == std::string::npos) {		// .gitkeep, half written caches
+			names.push_back(dir + "/" + name);
+		}
+#ifdef _WIN32
+	} while (FindNextFileA(find, &found));
+	FindClose(find);
+#else
+	}
+	closedir(directoryStream);
+#endif
+}
+
+static bool endsWith(const std::string& text, const std::string& suffix) {
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static bool isImage(const std::string& name) {
+	std::string lower(name);
+	std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return endsWith(lower, ".png") || endsWith(lower, ".jpg") || endsWith(lower, ".jpeg");
+}
+
+static bool readAsset(PackedAsset& asset) {
+	MappedFile file;
+	struct stat info;
+	if (stat(asset.path.c_str(), &info) != 0 || (!file.open(asset.path.c_str()) && info.st_size != 0)) {
+		std::cout << "ERROR::ASSET_PACKER::FILE_NOT_SUCCESFULLY_READ: " << asset.path << std::endl;
+		return false;
+	}
+	std::memset(&asset.entry, 0, sizeof(AssetPackEntry));
+	asset.entry.size = file.size();
+	asset.entry.mtime = static_cast<int64_t>(info.st_mtime);
+	asset.entry.hash = AssetPack::hashBytes(file.data(), file.size());
+
+	std::vector<char> compressed;
+	size_t blocks = (file.size() + AssetPack::BLOCK_SIZE - 1) / AssetPack::BLOCK_SIZE;
+	if (blocks > 0 && !endsWith(asset.name, ".vrmesh") && !endsWith(asset.name, ".vrtex")) {
+		std::vector<uint32_t> sizes(blocks);
+		std::vector<char> payload;
+		for (size_t b = 0; b < blocks; b++) {
+			const char* block = file.data() + b * AssetPack::BLOCK_SIZE;
+			size_t blockSize = std::min(AssetPack::BLOCK_SIZE, file.size() - b * AssetPack::BLOCK_SIZE);
+			size_t start = payload.size();
+			size_t packedSize = Lz4Block::compress(block, blockSize, payload);
+			if (packedSize < blockSize) {
+				sizes[b] = static_cast<uint32_t>(packedSize) | AssetPack::COMPRESSED_BLOCK;
+			}
+			else {
+				payload.resize(start);
+				payload.insert(payload.end(), block, block + blockSize);
+				sizes[b] = static_cast<uint32_t>(blockSize);
+			}
+		}
+		compressed.resize(blocks * 4);
+		std::memcpy(compressed.data(), sizes.data(), blocks * 4);
+		compressed.insert(compressed.end(), payload.begin(), payload.end());
+	}
+	if (!compressed.empty() && compressed.size() <= file.size() - file.size() / 8) {
+		asset.data = std::move(compressed);
+		asset.entry.flags = AssetPack::COMPRESSED;
+		asset.entry.blockCount = static_cast<uint32_t>(blocks);
+	}
+	else {
+		asset.data.assign(file.data(), file.data() + file.size());
+	}
+	asset.entry.storedSize = asset.data.size();
+	return true;
+}
+
+static size_t align(size_t offset) {
+	return (offset + AssetPack::ALIGNMENT - 1) / AssetPack::ALIGNMENT * AssetPack::ALIGNMENT;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 4) {
+		std::cout << "Usage: AssetPacker output.vrpack root dir [dir ...]" << std::endl;
+		return 1;
+	}
+	std::string output = argv[1];
+	std::string root = argv[2];
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::vector<std::string> names;
+	for (int i = 3; i < argc; i++) {
+		listFiles(root, argv[i], names);
+	}
+	// bake the caches, Mesh writes the .vrmesh next to each .obj and TextureBaker the .vrtex next to each image
+	// (fresh ones are only checked). Cube map faces are sampled top down, every other texture flipped
+	size_t textures = 0;
+	for (const std::string& name : names) {
+		if (endsWith(name, ".obj")) {
+			Mesh mesh((root + "/" + name).c_str());
+		}
+		else if (isImage(name)) {
+			bool flipped = name.find("cubemaps/") == std::string::npos;
+			textures += TextureBaker::bake(root + "/" + name, flipped) ? 1 : 0;
+		}
+	}
+	names.clear();
+	for (int i = 3; i < argc; i++) {
+		listFiles(root, argv[i], names);
+	}
+	std::sort(names.begin(), names.end(), [](const std::string& a, const std::string& b) {
+		return AssetPack::compare(a.data(), a.size(), b.data(), b.size()) < 0;
+	});
+
+	std::vector<PackedAsset> assets(names.size());
+	std::string nameTable;
+	for (size_t i = 0; i < names.size(); i++) {
+		assets[i].name = names[i];
+		assets[i].path = root + "/" + names[i];
+		if (!readAsset(assets[i])) {
+			return 1;
+		}
+		assets[i].entry.nameOffset = nameTable.size();
+		assets[i].entry.nameLength = static_cast<uint32_t>(names[i].size());
+		nameTable += names[i];
+	}
+
+	AssetPackHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, "VRPACK\0", 8);
+	header.version = AssetPack::VERSION;
+	header.headerSize = sizeof(AssetPackHeader);
+	header.entryCount = static_cast<uint32_t>(assets.size());
+	header.entrySize = sizeof(AssetPackEntry);
+	header.tocOffset = sizeof(AssetPackHeader);
+	header.namesOffset = header.tocOffset + assets.size() * sizeof(AssetPackEntry);
+	header.namesSize = nameTable.size();
+	size_t offset = align(header.namesOffset + header.namesSize);
+	for (PackedAsset& asset : assets) {
+		asset.entry.dataOffset = offset;
+		offset = align(offset + asset.data.size());
+	}
+
+	std::vector<char> toc(header.namesSize + assets.size() * sizeof(AssetPackEntry));
+	for (size_t i = 0; i < assets.size(); i++) {
+		std::memcpy(toc.data() + i * sizeof(AssetPackEntry), &assets[i].entry, sizeof(AssetPackEntry));
+	}
+	std::memcpy(toc.data() + assets.size() * sizeof(AssetPackEntry), nameTable.data(), nameTable.size());
+	header.tocHash = AssetPack::hashBytes(toc.data(), toc.size());
+
+	// written next to the output and renamed, like the .vrmesh caches
+	std::string temporary = output + ".tmp";
+	FILE* file = std::fopen(temporary.c_str(), "wb");
+	if (file == nullptr) {
+		std::cout << "ERROR::ASSET_PACKER::CANNOT_WRITE: " << output << std::endl;
+		return 1;
+	}
+	bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 && std::fwrite(toc.data(), 1, toc.size(), file) == toc.size();
+	size_t position = sizeof(header) + toc.size();
+	uint64_t storedBytes = 0, assetBytes = 0;
+	static const char padding[AssetPack::ALIGNMENT] = {};
+	for (const PackedAsset& asset : assets) {
+		written = written && std::fwrite(padding, 1, asset.entry.dataOffset - position, file) == asset.entry.dataOffset - position;
+		written = written && std::fwrite(asset.data.data(), 1, asset.data.size(), file) == asset.data.size();
+		position = asset.entry.dataOffset + asset.data.size();
+		storedBytes += asset.entry.storedSize;
+		assetBytes += asset.entry.size;
+	}
+	written = std::fclose(file) == 0 && written;
+	std::remove(output.c_str());
+	if (!written || std::rename(temporary.c_str(), output.c_str()) != 0) {
+		std::remove(temporary.c_str());
+		std::cout << "ERROR::ASSET_PACKER::CANNOT_WRITE: " << output << std::endl;
+		return 1;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << output << ": " << assets.size() << " files (" << textures << " textures baked), " << assetBytes / 1024
+		<< " KiB stored in " << storedBytes / 1024 << " KiB, " << seconds << " s" << std::endl;
+	return 0;
+}
@@ -0,0 +1,175 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include <glad/glad.h>
+
+// Space in the UploadRing: write size bytes to data, then let the GL read them from the buffer at offset
+struct UploadRegion {
+	char* data = nullptr;
+	size_t offset = 0;
+	size_t size = 0;
+
+	explicit operator bool() const { return data != nullptr; }
+};
+
+// One pixel unpack buffer, persistently and coherently mapped, handed out as a ring. The loader threads reserve a region
+// and write the texels straight into it, the main thread only issues the copies into the textures and puts a fence
+// behind them. A region is reused once its fence signaled, so the driver never has to copy from client memory and
+// nothing waits for the GPU. Needs GL_ARB_buffer_storage (GL 4.4), create returns false without it
+class UploadRing
+{
+public:
+	static const size_t ALIGNMENT = 64;
+
+	UploadRing() {}
+
+	UploadRing(const UploadRing&) = delete;
+	UploadRing& operator=(const UploadRing&) = delete;
+
+	// main thread
+	bool create(size_t bytes) {
+		if (!GLAD_GL_ARB_buffer_storage || buffer != 0) {
+			return buffer != 0;
+		}
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, flags);
+		mapped = static_cast<char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags));
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (mapped == nullptr) {
+			glDeleteBuffers(1, &buffer);
+			buffer = 0;
+			return false;
+		}
+		capacity = bytes;
+		return true;
+	}
+
+	// main thread, after close. Regions still reserved are lost
+	void destroy() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (Allocation& allocation : allocations) {
+			if (allocation.fence != nullptr) {
+				glDeleteSync(allocation.fence);
+			}
+		}
+		allocations.clear();
+		if (buffer != 0) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glDeleteBuffers(1, &buffer);
+		}
+		buffer = 0;
+		mapped = nullptr;
+		capacity = 0;
+		head = 0;
+	}
+
+	GLuint name() const {
+		return buffer;
+	}
+
+	// Any thread. Waits until the GPU finished reading enough of the ring. Returns an empty region if the ring does not
+	// exist, is closed, or could never hold size bytes; the caller then uploads from its own memory.
+	// Reserve everything a job needs at once, a job waiting for a second region could wait for its own first one
+	UploadRegion reserve(size_t size) {
+		size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		std::unique_lock<std::mutex> lock(mutex);
+		size_t offset = 0;
+		freed.wait(lock, [&]() { return closed || capacity == 0 || size >= capacity || fits(size, offset); });
+		if (closed || capacity == 0 || size >= capacity) {
+			return UploadRegion();
+		}
+		allocations.push_back(Allocation{ offset, nullptr, false });
+		head = offset + size;
+		UploadRegion region;
+		region.data = mapped + offset;
+		region.offset = offset;
+		region.size = size;
+		return region;
+	}
+
+	// main thread, right after the commands reading region were issued
+	void release(const UploadRegion& region) {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (Allocation& allocation : allocations) {
+			if (allocation.offset == region.offset && !allocation.released) {
+				allocation.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				allocation.released = true;
+				return;
+			}
+		}
+	}
+
+	// main thread, once per frame: reclaims the regions the GPU is done with, oldest first
+	void retire() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			while (!allocations.empty() && allocations.front().released) {
+				GLenum status = glClientWaitSync(allocations.front().fence, 0, 0);
+				if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+					break;
+				}
+				glDeleteSync(allocations.front().fence);
+				allocations.pop_front();
+			}
+			if (allocations.empty()) {
+				head = 0;
+			}
+		}
+		freed.notify_all();
+	}
+
+	// wakes and fails every waiting reserve, e.g. before the loader threads are joined
+	void close() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+		}
+		freed.notify_all();
+	}
+
+private:
+	struct Allocation {
+		size_t offset;
+		GLsync fence;
+		bool released;
+	};
+
+	GLuint buffer = 0;
+	char* mapped = nullptr;
+	size_t capacity = 0;
+	size_t head = 0;		// where the next region goes
+	std::deque<Allocation> allocations;		// oldest first, in ring order
+	std::mutex mutex;
+	std::condition_variable freed;
+	bool closed = false;
+
+	// Free space is [head, capacity) and [0, tail) while the oldest region at tail lies before head, [head, tail) after the
+	// ring wrapped. A region never ends exactly at tail, so head == tail only when the ring is empty
+	bool fits(size_t size, size_t& offset) const {
+		if (allocations.empty()) {
+			offset = 0;
+			return true;
+		}
+		size_t tail = allocations.front().offset;
+		if (head > tail) {
+			if (head + size <= capacity) {
+				offset = head;
+				return true;
+			}
+			offset = 0;
+			return size < tail;
+		}
+		offset = head;
+		return head + size < tail;
+	}
+};
+#endif
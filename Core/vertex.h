@@ -0,0 +1,14 @@
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include <glm/glm.hpp>
+
+// interleaved layout uploaded by Object::makeObject: 3 position, 2 texture and 3 normal floats
+struct Vertex {
+	glm::vec3 Position;
+	glm::vec2 Texture;
+	glm::vec3 Normal;
+};
+
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex must stay tightly packed, it is uploaded as is");
+#endif
@@ -0,0 +1,88 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "bounds.h"
+#include "vertex.h"
+
+// Vertex layouts Mesh::makeObject can upload. The shaders read vec3/vec2 attributes in every case,
+// the GL unpacks the compact ones while fetching
+enum class VertexFormat {
+	Float32,		// 32 bytes, Vertex as is
+	Half,			// 16 bytes, half float positions
+	Snorm16,		// 16 bytes, positions as normalized int16 inside the mesh bounds, needs Mesh::positionDecode in the model matrix
+};
+
+// Common 16 byte layout of VertexFormat::Half and VertexFormat::Snorm16
+struct CompactVertex {
+	uint16_t Position[4];		// xyz, w is padding
+	uint32_t Normal;			// GL_INT_2_10_10_10_REV
+	uint16_t Texture[2];		// unsigned normalized when every uv lies in [0, 1], half floats otherwise
+};
+
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex is uploaded as is");
+
+class VertexPacker
+{
+public:
+	// Converts vertices to the compact layout. positionDecode receives the matrix that maps the stored positions
+	// back to object space (identity unless format is Snorm16), normalizedTexture tells how the uvs were stored
+	static std::vector<CompactVertex> pack(const Vertex* vertices, size_t count, VertexFormat format,
+		glm::mat4& positionDecode, bool& normalizedTexture) {
+		normalizedTexture = true;
+		for (size_t i = 0; i < count; i++) {
+			const Vertex& v = vertices[i];
+			normalizedTexture = normalizedTexture && v.Texture.x >= 0.0f && v.Texture.x <= 1.0f && v.Texture.y >= 0.0f && v.Texture.y <= 1.0f;
+		}
+
+		BoundingBox box = BoundingBox::around(vertices, count);
+		glm::vec3 center = box.empty() ? glm::vec3(0.0f) : box.center();
+		glm::vec3 halfExtent = box.halfExtent();
+		for (int axis = 0; axis < 3; axis++) {
+			if (halfExtent[axis] <= 0.0f) {
+				halfExtent[axis] = 1.0f;		// flat along this axis, any scale decodes to the center
+			}
+		}
+		positionDecode = glm::mat4(1.0f);
+		if (format == VertexFormat::Snorm16) {
+			positionDecode = glm::scale(glm::translate(glm::mat4(1.0f), center), halfExtent);
+		}
+
+		std::vector<CompactVertex> packed(count);
+		for (size_t i = 0; i < count; i++) {
+			const Vertex& v = vertices[i];
+			CompactVertex& c = packed[i];
+			for (int axis = 0; axis < 3; axis++) {
+				if (format == VertexFormat::Snorm16) {
+					c.Position[axis] = glm::packSnorm1x16((v.Position[axis] - center[axis]) / halfExtent[axis]);
+				}
+				else {
+					c.Position[axis] = glm::packHalf1x16(v.Position[axis]);
+				}
+			}
+			c.Position[3] = 0;
+			c.Normal = packNormal(v.Normal);
+			for (int axis = 0; axis < 2; axis++) {
+				c.Texture[axis] = normalizedTexture ? glm::packUnorm1x16(v.Texture[axis]) : glm::packHalf1x16(v.Texture[axis]);
+			}
+		}
+		return packed;
+	}
+
+	// signed 10 bit x, y, z (w = 0) as expected by GL_INT_2_10_10_10_REV
+	static uint32_t packNormal(const glm::vec3& normal) {
+		uint32_t packed = 0;
+		for (int axis = 0; axis < 3; axis++) {
+			int value = static_cast<int>(glm::round(glm::clamp(normal[axis], -1.0f, 1.0f) * 511.0f));
+			packed |= (static_cast<uint32_t>(value) & 0x3ffu) << (10 * axis);
+		}
+		return packed;
+	}
+};
+#endif